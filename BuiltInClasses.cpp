@@ -20,6 +20,8 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <iomanip>
+#include <climits>
 #include "BuiltInClasses.h"
 #include "main.h"
 
@@ -61,6 +63,26 @@ string BuiltInClass::generateAttributeSetter(string memberName, string attribute
     return oss.str();
 }
 
+string BuiltInClass::generateWriter() const {
+    throw runtime_error("generateWriter() called in BuiltInClass");
+}
+
+string BuiltInClass::generateElementWriter(string memberName, string nodeName, string tabs) const {
+    ostringstream oss;
+
+    oss << tabs << "write(\"<" << nodeName << ">\" + xmlEscape(str(" << memberName << ")) + \"</" << nodeName << ">\")" << endl;
+
+    return oss.str();
+}
+
+string BuiltInClass::generateAttributeWriter(string memberName, string attributeName, string tabs) const {
+    ostringstream oss;
+
+    oss << tabs << "write(' " << attributeName << "=\"' + xmlEscape(str(" << memberName << ")) + '\"')" << endl;
+
+    return oss.str();
+}
+
 string BuiltInClass::generateParser() const {
     throw runtime_error("generateParser() called in BuiltInClass");
 }
@@ -73,18 +95,85 @@ string BuiltInClass::generateMemberSetter(string memberName, string nodeName, st
     oss << tabs << "else:" << endl;
 
     oss << tabs << t << memberName << " = ";
-    string type = getClassname();
-    if(type == "int" || type == "short" || type == "unsignedShort" || type == "unsignedInt" || type == "byte" || type == "unsignedByte") {
-        oss << "int(node.firstChild.nodeValue)";
+    //the XML Schema name, since getClassname() gives the C++ type (long long, unsigned char...)
+    const string& type = name.second;
+    if(type == "int" || type == "integer" || type == "short" || type == "unsignedShort" || type == "unsignedInt" || type == "byte" || type == "unsignedByte") {
+        oss << "int(getText(node))";
     } else if(type == "long" || type == "unsignedLong") {
-        oss << "long(node.firstChild.nodeValue)";
+        oss << "long(getText(node))";
     } else if(type == "float" || type == "double") {
-        oss << "float(node.firstChild.nodeValue)";
+        oss << "float(getText(node))";
     } else if(type == "string") {
-        oss << "node.firstChild.nodeValue";
+        oss << "getText(node)";
     } else {
-        oss << "str(node.firstChild.nodeValue)";
+        oss << "str(getText(node))";
     } 
 
     return oss.str();
 }
+
+static string sampleDate(const SampleOptions& options) {
+    ostringstream oss;
+
+    //days past the 28th are left out so that every date is valid
+    oss << setfill('0') << setw(4) << options.randomInt(1970, 2037) << "-" << setw(2) << options.randomInt(1, 12) << "-" << setw(2) << options.randomInt(1, 28);
+
+    return oss.str();
+}
+
+static string sampleTime(const SampleOptions& options) {
+    ostringstream oss;
+
+    oss << setfill('0') << setw(2) << options.randomInt(0, 23) << ":" << setw(2) << options.randomInt(0, 59) << ":" << setw(2) << options.randomInt(0, 59);
+
+    return oss.str();
+}
+
+string BuiltInClass::generateSampleValue(const SampleOptions& options) const {
+    const string& type = name.second;
+    ostringstream oss;
+
+    if(type == "byte") {
+        oss << options.randomInt(-128, 127);
+    } else if(type == "unsignedByte") {
+        oss << options.randomInt(0, 255);
+    } else if(type == "short") {
+        oss << options.randomInt(-32768, 32767);
+    } else if(type == "unsignedShort") {
+        oss << options.randomInt(0, 65535);
+    } else if(type == "int" || type == "integer") {
+        oss << options.randomInt(INT_MIN, INT_MAX);
+    } else if(type == "unsignedInt") {
+        oss << options.randomInt(0, INT_MAX);
+    } else if(type == "long") {
+        //at most 18 digits, which always fits in a signed 64-bit integer
+        oss << (options.randomInt(0, 1) ? "-" : "") << options.randomDigits(options.randomInt(1, 18));
+    } else if(type == "unsignedLong") {
+        oss << options.randomDigits(options.randomInt(1, 19));
+    } else if(type == "float" || type == "double") {
+        oss << options.randomInt(-1000000, 1000000) / 100.0;
+    } else if(type == "boolean") {
+        oss << (options.randomInt(0, 1) ? "true" : "false");
+    } else if(type == "hexBinary") {
+        const char *digits = "0123456789ABCDEF";
+
+        for(int x = 2 * options.randomInt(options.minStringLength, options.maxStringLength); x > 0; x--)
+            oss << digits[options.randomInt(0, 15)];
+    } else if(type == "date") {
+        oss << sampleDate(options);
+    } else if(type == "time") {
+        oss << sampleTime(options);
+    } else if(type == "dateTime") {
+        oss << sampleDate(options) << "T" << sampleTime(options);
+    } else if(type == "language") {
+        const char *languages[] = {"en", "en-US", "sv", "de", "fr"};
+
+        oss << languages[options.randomInt(0, 4)];
+    } else if(type == "anyURI") {
+        oss << "http://example.com/" << options.randomString();
+    } else {
+        oss << options.randomString();
+    }
+
+    return oss.str();
+}
@@ -33,8 +33,12 @@ public:
     std::string generateAppender() const;
     virtual std::string generateElementSetter(std::string memberName, std::string nodeName, std::string tabs) const;
     virtual std::string generateAttributeSetter(std::string memberName, std::string attributeName, std::string tabs) const;
+    std::string generateWriter() const;
+    virtual std::string generateElementWriter(std::string memberName, std::string nodeName, std::string tabs) const;
+    virtual std::string generateAttributeWriter(std::string memberName, std::string attributeName, std::string tabs) const;
     std::string generateParser() const;
     virtual std::string generateMemberSetter(std::string memberName, std::string nodeName, std::string tabs) const;
+    std::string generateSampleValue(const SampleOptions& options) const;
 };
 
 #define GENERATE_BUILTIN(name, xslName, classname)\
@@ -135,6 +139,10 @@ GENERATE_BUILTIN(BooleanClass, "boolean", "bool")
         return oss.str();
     }
 
+    std::string generateElementWriter(std::string memberName, std::string nodeName, std::string tabs) const {
+        return tabs + "write(\"<" + nodeName + ">\" + xmlEscape(str(" + memberName + ").lower()) + \"</" + nodeName + ">\")\n";
+    }
+
     std::string generateMemberSetter(std::string memberName, std::string nodeName, std::string tabs) const {
         return tabs + memberName + " = bool(node.firstChild.nodeValue)";
     }
@@ -22,10 +22,24 @@
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
 
 using namespace std;
 
 extern bool verbose;
+extern bool useExpat;
+extern bool useNative;
+extern bool useLazy;
+extern bool useTypedArrays;
+extern bool useDirty;
+extern bool useInstrument;
+extern int inlineDepth;
+extern bool useValidation;
 
 const string variablePostfix = "_james";
 
@@ -37,11 +51,11 @@ const string ssWithPostfix = "ss" + variablePostfix;
 const string t = "    "; // Python indentation step (four spaces)
 
 Class::Class(FullName name, ClassType type) : name(name), type(type), 
-        isDocument(false), base(NULL)  {
+        isDocument(false), interned(false), base(NULL)  {
 }
 
 Class::Class(FullName name, ClassType type, FullName baseType) : name(name),
-        type(type), isDocument(false), baseType(baseType), base(NULL) {
+        type(type), isDocument(false), interned(false), baseType(baseType), base(NULL) {
 }
 
 Class::~Class() {
@@ -110,266 +124,1826 @@ void Class::addMember(Member memberInfo) {
     members.push_back(memberInfo);
 }
 
+/**
+ * Returns the name of the Python callable that converts the text of a value of the built-in class cl,
+ * or an empty string if cl isn't built-in.
+ * Attribute values are left as strings unless they are numeric or enumerated.
+ */
+static string getConverter(const Class *cl, bool isAttribute) {
+    if(!cl->isBuiltIn())
+        return !isAttribute ? "" : cl->enumerations.empty() ? "str" : cl->getClassname() + ".from_value";
+
+    string type = cl->name.second;
+
+    if(type == "int" || type == "integer" || type == "short" || type == "unsignedShort" || type == "unsignedInt" || type == "byte" || type == "unsignedByte")
+        return "int";
+    else if(type == "long" || type == "unsignedLong")
+        return "long";
+    else if(type == "float" || type == "double")
+        return "float";
+    else if(type == "boolean" && !isAttribute)
+        return "strToBool";
+    else if(type == "hexBinary" && !isAttribute)
+        return "strToHex";
+    else
+        return "str";
+}
+
+/**
+ * Returns str as a Python string literal.
+ */
+static string quotePython(const string& str) {
+    const char *digits = "0123456789abcdef";
+    string ret = "\"";
+
+    for(string::const_iterator it = str.begin(); it != str.end(); it++) {
+        unsigned char c = *it;
+
+        if(c == '"' || c == '\\') {
+            ret += '\\';
+            ret += c;
+        } else if(c < 32 || c >= 127) {
+            ret += "\\x";
+            ret += digits[c >> 4];
+            ret += digits[c & 15];
+        } else
+            ret += c;
+    }
+
+    return ret + "\"";
+}
+
+/**
+ * Reads the character at pos of str, which is valid UTF-8 as checked when the schema was read.
+ */
+static unsigned readUTF8(const string& str, size_t& pos) {
+    unsigned char c = str[pos++];
+
+    if(c < 0x80)
+        return c;
+
+    int more = (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : 3;
+    unsigned value = c & (0x3F >> more);
+
+    for(; more > 0 && pos < str.size(); more--)
+        value = (value << 6) | (str[pos++] & 0x3F);
+
+    return value;
+}
+
+/**
+ * Appends the character c to out as UTF-8.
+ */
+static void appendUTF8(string& out, unsigned c) {
+    if(c < 0x80) {
+        out += (char)c;
+    } else if(c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    } else if(c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    } else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+/**
+ * Returns the UTF-8 string str as a Python unicode literal, with the non-ASCII characters written as \\u or \\U escapes.
+ */
+static string quotePythonUnicode(const string& str) {
+    const char *digits = "0123456789abcdef";
+    string ret = "u\"";
+
+    for(size_t x = 0; x < str.size();) {
+        unsigned value = readUTF8(str, x);
+
+        if(value < 0x80) {
+            //escaped the same way as by quotePython()
+            string quoted = quotePython(string(1, (char)value));
+            ret += quoted.substr(1, quoted.size() - 2);
+            continue;
+        }
+
+        ret += value < 0x10000 ? "\\u" : "\\U";
+
+        for(int shift = value < 0x10000 ? 12 : 28; shift >= 0; shift -= 4)
+            ret += digits[(value >> shift) & 15];
+    }
+
+    return ret + "\"";
+}
+
+/**
+ * Returns the array.array typecode of the built-in numeric class cl, or an empty string if cl isn't numeric.
+ * long and unsignedLong use the platform's C long, which is 64 bits except on Windows.
+ */
+static string getNumericTypecode(const Class *cl) {
+    string type = cl->name.second;
+
+    if(type == "byte")
+        return "b";
+    else if(type == "unsignedByte")
+        return "B";
+    else if(type == "short")
+        return "h";
+    else if(type == "unsignedShort")
+        return "H";
+    else if(type == "int")
+        return "i";
+    else if(type == "unsignedInt")
+        return "I";
+    else if(type == "integer" || type == "long")
+        return "l";
+    else if(type == "unsignedLong")
+        return "L";
+    else if(type == "float")
+        return "f";
+    else if(type == "double")
+        return "d";
+    else
+        return "";
+}
+
+/**
+ * Returns the array.array typecode with which the array member is stored when --typed-arrays is given,
+ * or an empty string if it is stored in a list.
+ */
+static string getTypecode(const Class::Member& member) {
+    if(!useTypedArrays || !member.isArray() || !member.cl->isBuiltIn())
+        return "";
+
+    return getNumericTypecode(member.cl);
+}
+
+/**
+ * Returns the built-in class at the bottom of the base chain of a simple class, or NULL if there is none.
+ */
+static const Class *getBuiltInBase(const Class *cl) {
+    while(cl && !cl->isBuiltIn())
+        cl = cl->base;
+
+    return cl;
+}
+
+/**
+ * Returns true if cl or any of its simple bases was given to --intern.
+ */
+static bool isInterned(const Class *cl) {
+    for(; cl; cl = cl->isSimple() ? cl->base : NULL)
+        if(cl->interned)
+            return true;
+
+    return false;
+}
+
+/**
+ * Returns the converter of the value of member, which interns strings of interned members and types.
+ */
+static string getMemberConverter(const Class::Member& member) {
+    string converter = getConverter(member.cl, member.isAttribute);
+
+    return converter == "str" && (member.interned || isInterned(member.cl)) ? "strToInterned" : converter;
+}
+
+/**
+ * Returns the converter of the text content of the simple class cl, which interns strings of interned types.
+ */
+static string getContentConverter(const Class *cl) {
+    string converter = getConverter(getBuiltInBase(cl), false);
+
+    return converter == "str" && isInterned(cl) ? "strToInterned" : converter;
+}
+
+/**
+ * Returns the converter of the values of member in the columns of to_columns() and iter_columns(),
+ * which hold the content of simple types rather than objects.
+ */
+static string getColumnConverter(const Class::Member& member) {
+    if(member.cl->isBuiltIn() || (member.isAttribute && member.cl->enumerations.empty()))
+        return getMemberConverter(member);
+
+    string converter = getContentConverter(member.cl);
+
+    return converter == "str" && member.interned ? "strToInterned" : converter;
+}
+
+/**
+ * Returns the typecode of the array.array column of a value converted by converter,
+ * or an empty string if the column is a list.
+ */
+static string getColumnTypecode(const Class *cl, const string& converter, bool required) {
+    const Class *builtIn = getBuiltInBase(cl);
+
+    if(!required || !builtIn || (converter != "int" && converter != "long" && converter != "float"))
+        return "";
+
+    return getNumericTypecode(builtIn);
+}
+
+/**
+ * Gathers the members of cl and its base chain, base first, split into attributes and elements.
+ * Members of unknown classes are left out.
+ * Returns the simple base at the bottom of the chain for simple types and simpleContent, otherwise NULL.
+ */
+static const Class *getChainMembers(const Class *cl, list<Class::Member>& attributes, list<Class::Member>& elements) {
+    for(; cl && !cl->isSimple(); cl = cl->base) {
+        list<Class::Member> ourAttributes, ourElements;
+
+        for(list<Class::Member>::const_iterator it = cl->members.begin(); it != cl->members.end(); it++) {
+            if(!it->cl)
+                continue;
+
+            if(it->isAttribute)
+                ourAttributes.push_back(*it);
+            else
+                ourElements.push_back(*it);
+        }
+
+        attributes.splice(attributes.begin(), ourAttributes);
+        elements.splice(elements.begin(), ourElements);
+    }
+
+    return cl;
+}
+
+/**
+ * Returns the james::native::Kind with which the extension module does the same as the Python converter.
+ */
+static string getNativeKind(const string& converter) {
+    if(converter == "int")
+        return "INT";
+    else if(converter == "long")
+        return "LONG";
+    else if(converter == "float")
+        return "FLOAT";
+    else if(converter == "strToBool")
+        return "BOOL";
+    else if(converter == "strToHex")
+        return "HEX";
+    else if(converter == "strToInterned")
+        return "INTERNED";
+    else
+        return "STRING";
+}
+
 /**
  * Default implementation of generateAppender()
  */
 string Class::generateAppender() const {
     ostringstream oss;
 
-    oss << t << endl;
-    oss << t << "def append_children(self, node, document):" << endl;
+    oss << t << endl;
+    oss << t << "def append_children(self, node, document):" << endl;
+
+    /* nop statement to handle a node with no children */
+    oss << t << t << "pass" << endl;
+
+    if(base) {
+        if(base->isSimple()) {
+            //simpleContent
+            oss << t << t << "tmpText = document.createTextNode(str(self.content))" << endl;
+            oss << t << t << "node.appendChild(tmpText)" << endl;
+        } else {
+            //call base appender
+            oss << t << t << base->getClassname() << ".append_children(self, node, document);" << endl;
+        }
+    } 
+    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
+        if (!it->cl)
+            continue;
+
+        string name = it->name;
+        string setterName = it->name;
+        string nodeName = name + "Node";
+        string et = t+t; // Extra tabs
+        string subName = "self." + name;
+
+        if(it != members.begin())
+            oss << endl;
+
+        if(it->isOptional()) {
+            oss << et << "if self." << name << " != None:" << endl;
+            et = et + t;
+        }
+        if(it->isArray()) {
+            //arrays may also be iterators or generators, so don't ask for their length
+            oss << et << "for value in self." << name << ":" << endl;
+            subName = "value";
+            et = et + t;
+        } 
+           
+        if(it->isAttribute) {
+            //attribute
+            oss << it->cl->generateAttributeSetter(name, subName, et);
+        } else {
+            //element
+            oss << it->cl->generateElementSetter(subName, name, et);
+        }
+    }
+
+    return oss.str();
+}
+
+string Class::generateElementSetter(string memberName, string nodeName, string tabs) const {
+    ostringstream oss;
+    if(isSimple() && base)
+        return base->generateElementSetter(memberName, nodeName, tabs);
+
+    oss << tabs << "tmp = document.createElement(\"" << nodeName << "\")" << endl;
+    oss << tabs << "node.appendChild(tmp)" << endl;
+    oss << tabs << memberName << ".append_children(tmp, document)" << endl;
+    return oss.str();
+}
+
+string Class::generateAttributeSetter(string memberName, string attributeName, string tabs) const {
+    if(isSimple() && base)
+        return base->generateAttributeSetter(memberName, attributeName, tabs);
+
+    throw runtime_error("Tried to generateAttributeSetter() for a non-simple Class");
+}
+
+string Class::generateWriter() const {
+    ostringstream oss;
+    list<Member> attributes, elements;
+    const Class *content = getChainMembers(this, attributes, elements);
+
+    oss << t << endl;
+    //with --dirty this renders the XML text which writeCached() keeps around
+    oss << t << "def " << (useDirty ? "render_xml" : "write_xml") << "(self, write, name, xmlns = None):" << endl;
+    oss << t << t << "write(\"<\" + name)" << endl;
+
+    //attributes sorted by name, as minidom writes them before Python 3.8, so the output doesn't depend on the Python version
+    map<string, Member> sortedAttributes;
+    bool wroteXmlns = false;
+
+    for(list<Member>::const_iterator it = attributes.begin(); it != attributes.end(); it++)
+        sortedAttributes[it->name] = *it;
+
+    for(map<string, Member>::const_iterator it = sortedAttributes.begin(); it != sortedAttributes.end(); it++) {
+        string et = t+t;
+
+        if(!wroteXmlns && it->first > "xmlns") {
+            oss << t << t << "if xmlns != None:" << endl;
+            oss << t << t << t << "write(' xmlns=\"' + xmlEscape(xmlns) + '\"')" << endl;
+            wroteXmlns = true;
+        }
+
+        if(it->second.isOptional()) {
+            oss << et << "if self." << it->first << " != None:" << endl;
+            et += t;
+        }
+
+        oss << it->second.cl->generateAttributeWriter("self." + it->first, it->first, et);
+    }
+
+    if(!wroteXmlns) {
+        oss << t << t << "if xmlns != None:" << endl;
+        oss << t << t << t << "write(' xmlns=\"' + xmlEscape(xmlns) + '\"')" << endl;
+    }
+
+    //figure out if the element can be empty, in which case it's closed right away like minidom does
+    bool alwaysChildren = content != NULL;
+    string noChildren;
+
+    for(list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        if(it->isRequired())
+            alwaysChildren = true;
+
+        if(!noChildren.empty())
+            noChildren += " and ";
+
+        if(it->isArray())
+            noChildren += "not self." + it->name;
+        else
+            noChildren += "self." + it->name + " == None";
+    }
+
+    if(!alwaysChildren) {
+        if(elements.empty()) {
+            oss << t << t << "write(\"/>\")" << endl;
+            return oss.str();
+        }
+
+        oss << t << t << "if " << noChildren << ":" << endl;
+        oss << t << t << t << "write(\"/>\")" << endl;
+        oss << t << t << t << "return" << endl;
+    }
+
+    oss << t << t << "write(\">\")" << endl;
+
+    if(content)
+        oss << t << t << "write(xmlEscape(str(self.content)))" << endl;
+
+    for(list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        if(it->isOptional()) {
+            oss << t << t << "if self." << it->name << " != None:" << endl;
+            oss << it->cl->generateElementWriter("self." + it->name, it->name, t+t+t);
+        } else if(!getTypecode(*it).empty()) {
+            //numbers need no escaping, so typed arrays are written in one go
+            oss << t << t << "values = \"</" << it->name << "><" << it->name << ">\".join(map(str, self." << it->name << "))" << endl;
+            oss << t << t << "if values:" << endl;
+            oss << t << t << t << "write(\"<" << it->name << ">\" + values + \"</" << it->name << ">\")" << endl;
+        } else if(it->isArray()) {
+            oss << t << t << "for value in self." << it->name << ":" << endl;
+            oss << it->cl->generateElementWriter("value", it->name, t+t+t);
+        } else
+            oss << it->cl->generateElementWriter("self." + it->name, it->name, t+t);
+    }
+
+    oss << t << t << "write(\"</\" + name + \">\")" << endl;
+
+    return oss.str();
+}
+
+string Class::generateElementWriter(string memberName, string nodeName, string tabs) const {
+    if(isSimple() && base)
+        return base->generateElementWriter(memberName, nodeName, tabs);
+
+    return tabs + memberName + ".write_xml(write, \"" + nodeName + "\")\n";
+}
+
+string Class::generateAttributeWriter(string memberName, string attributeName, string tabs) const {
+    if(isSimple() && base)
+        return base->generateAttributeWriter(memberName, attributeName, tabs);
+
+    throw runtime_error("Tried to generateAttributeWriter() for a non-simple Class");
+}
+
+string Class::generateParser() const {
+    ostringstream oss;
+
+    //members of the whole base chain, bound in a single pass over the children
+    list<Member> attributes, elements;
+    const Class *content = getChainMembers(this, attributes, elements);
+
+    //the simple type converting the text content of simple types and simpleContent, which may be further down the chain
+    const Class *contentType = isSimple() ? base : content;
+
+    oss << t << endl;
+    oss << t << "def parse_node(self, node):" << endl;
+
+    if(contentType) {
+        if(getContentConverter(content) == "strToInterned") {
+            oss << t << t << "if node.firstChild == None:" << endl;
+            oss << t << t << t << "self.content = None" << endl;
+            oss << t << t << "else:" << endl;
+            oss << t << t << t << "self.content = strToInterned(getText(node))" << endl;
+        } else {
+            //simpleContent
+            oss << contentType->generateMemberSetter("self.content", "content", t+t) << endl;
+        }
+    }
+
+    oss << endl;
+    oss << t << t << "for childNode in node.childNodes:" << endl;
+    oss << t << t << t << "if childNode.localName == None:" << endl;
+    oss << t << t << t << t << "continue" << endl;
+    oss << endl;
+
+    //TODO: replace this with a map<pair<string, DOMNode::ElementType>, void(*)(DOMNode*)> thing?
+    //in other words, lookin up parsing function pointers in a map should be faster then all these string comparisons
+    bool first = true;
+
+    for(std::list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        if(first)
+            first = false;
+        else
+            oss << endl;
+
+        oss << t << t << t << "if childNode.localName == \"" << it->name << "\" and childNode.nodeType == Node.ELEMENT_NODE:" << endl;
+
+        if(useLazy && !it->cl->isSimple()) {
+            //keep the node around and bind it when the member is first read, see bindLazy()
+            oss << t << t << t << t << "self.lazy_member(\"" << it->name << "\", " << it->type.second << ".fromNode, childNode";
+            oss << (it->isArray() ? ", True" : "") << ")" << endl;
+            continue;
+        }
+
+        oss << t << t << t << t << "self." << it->name;
+        if(it->isArray()) {
+            oss << ".append(";
+        } else {
+            oss << " = ";
+        }
+        string converter = getMemberConverter(*it);
+        if(converter.empty()) {
+            oss << it->type.second << ".fromNode(childNode)";
+        } else {
+            oss << converter << "(getText(childNode))";
+        }
+
+        if(it->isArray()) {
+            oss << ")" << endl;
+        } else {
+            oss << endl;
+        }
+    }
+
+    //attributes
+    for(std::list<Member>::const_iterator it = attributes.begin(); it != attributes.end(); it++) {
+        oss << t << t << endl;
+        oss << t << t << "if node.hasAttribute(\"" << it->name << "\"):" << endl;
+        oss << t << t << t << "self." << it->name << " = " << getMemberConverter(*it);
+        oss << "(node.getAttribute(\"" << it->name << "\"))" << endl;
+    }
+
+    return oss.str();
+}
+
+string Class::generateDictMethods() const {
+    ostringstream toDict, parseDict;
+
+    toDict << t << endl;
+    toDict << t << "def to_dict(self):" << endl;
+
+    parseDict << t << endl;
+    parseDict << t << "@classmethod" << endl;
+    parseDict << t << "def from_dict(cls, d):" << endl;
+    parseDict << t << t << "obj = cls()" << endl;
+    parseDict << t << t << "obj.parse_dict(d)" << endl;
+    parseDict << t << t << "return obj" << endl;
+    parseDict << t << endl;
+    parseDict << t << "def parse_dict(self, d):" << endl;
+
+    if(base && !base->isSimple()) {
+        toDict << t << t << "d = " << base->getClassname() << ".to_dict(self)" << endl;
+        parseDict << t << t << base->getClassname() << ".parse_dict(self, d)" << endl;
+    } else {
+        toDict << t << t << "d = {}" << endl;
+
+        //simpleContent
+        if(base) {
+            toDict << t << t << "d[\"content\"] = self.content" << endl;
+            parseDict << t << t << "self.content = d.get(\"content\")" << endl;
+        } else
+            parseDict << t << t << "pass" << endl;
+    }
+
+    for(list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
+        if(!it->cl)
+            continue;
+
+        string name = it->name;
+        string member = "self." + name;
+        string key = "d[\"" + name + "\"]";
+        string type = it->cl->getClassname();
+
+        toDict << t << t << key << " = ";
+        parseDict << t << t << member << " = ";
+
+        //attributes of simple types other than enumerations are parsed as plain strings, so they are copied as well
+        if(it->cl->isBuiltIn() || (it->isAttribute && it->cl->enumerations.empty())) {
+            //values are copied as they are
+            if(it->isArray()) {
+                string typecode = getTypecode(*it);
+
+                toDict << "list(" << member << ")" << endl;
+
+                if(getMemberConverter(*it) == "strToInterned")
+                    parseDict << "[strToInterned(value) for value in d.get(\"" << name << "\", ())]" << endl;
+                else if(typecode.empty())
+                    parseDict << "list(d.get(\"" << name << "\", ()))" << endl;
+                else
+                    parseDict << "array(\"" << typecode << "\", d.get(\"" << name << "\", ()))" << endl;
+            } else {
+                toDict << member << endl;
+
+                if(getMemberConverter(*it) == "strToInterned")
+                    parseDict << "strToInterned(" << key << ") if d.get(\"" << name << "\") != None else None" << endl;
+                else
+                    parseDict << "d.get(\"" << name << "\")" << endl;
+            }
+        } else {
+            //simple types are represented by their content, complex types by their own dicts
+            string toValue = it->cl->isSimple() ? ".content" : ".to_dict()";
+            string fromValue = !it->cl->isSimple() ? type + ".from_dict" : it->cl->enumerations.empty() && !isInterned(it->cl) ? type : type + ".from_value";
+
+            if(it->isArray()) {
+                toDict << "[value" << toValue << " for value in " << member << "]" << endl;
+                parseDict << "[" << fromValue << "(value) for value in d.get(\"" << name << "\", ())]" << endl;
+            } else {
+                toDict << member << toValue << " if " << member << " != None else None" << endl;
+                parseDict << fromValue << "(" << key << ") if d.get(\"" << name << "\") != None else None" << endl;
+            }
+        }
+    }
+
+    toDict << t << t << "return d" << endl;
+
+    return toDict.str() + parseDict.str();
+}
+
+string Class::generateStateMethods() const {
+    ostringstream oss;
+    list<Member> attributes, elements;
+    vector<string> names;
+    //generation options that change the types of the pickled values, for stateFingerprint()
+    string format = useDirty ? "dirty" : "";
+    const Class *content = getChainMembers(this, attributes, elements);
+
+    if(content) {
+        names.push_back("content");
+
+        if(getContentConverter(content) == "strToInterned")
+            format += " content:interned";
+    }
+
+    list<Member> all = attributes;
+    all.insert(all.end(), elements.begin(), elements.end());
+
+    for(list<Member>::const_iterator it = all.begin(); it != all.end(); it++) {
+        names.push_back(it->name);
+
+        if(!getTypecode(*it).empty())
+            format += " " + it->name + ":array(" + getTypecode(*it) + ")";
+
+        if(it->cl->isSimple() && getColumnConverter(*it) == "strToInterned")
+            format += " " + it->name + ":interned";
+    }
+
+    //the members as a tuple, or a one-element tuple if there is only one
+    string quoted, members;
+
+    for(vector<string>::const_iterator it = names.begin(); it != names.end(); it++) {
+        quoted += (it == names.begin() ? "" : ", ") + ("\"" + *it + "\"");
+        members += (it == names.begin() ? "" : ", ") + ("self." + *it);
+    }
+
+    if(names.size() == 1) {
+        quoted += ",";
+        members += ",";
+    }
+
+    oss << t << endl;
+    oss << t << "_state_members = (" << quoted << ")" << endl;
+    oss << t << "_state_format = \"" << format << "\"" << endl;
+    oss << t << endl;
+    oss << t << "def __getstate__(self):" << endl;
+    oss << t << t << "return (" << members << ")" << endl;
+    oss << t << endl;
+    oss << t << "def __setstate__(self, state):" << endl;
+
+    if(names.empty())
+        oss << t << t << "pass" << endl;
+    else
+        oss << t << t << "(" << members << ") = state" << endl;
+
+    return oss.str();
+}
+
+/**
+ * Returns true if str can be written as is as a Python integer literal.
+ */
+static bool isIntegerLiteral(const string& str) {
+    size_t start = str.size() > 1 && str[0] == '-' ? 1 : 0;
+
+    //no leading zeros, they would make it octal in Python 2
+    return str.size() > start && str.find_first_not_of("0123456789", start) == string::npos && (str[start] != '0' || str.size() == start + 1);
+}
+
+/**
+ * Returns true if values of the simple class cl or its simple bases are restricted by any facets or enumerations.
+ */
+static bool hasFacets(const Class *cl) {
+    for(; cl && !cl->isBuiltIn(); cl = cl->base)
+        if(!cl->facets.empty() || !cl->enumerations.empty())
+            return true;
+
+    return false;
+}
+
+/**
+ * Returns code raising ValueError if the local variable value breaks any facet of the simple class cl or its simple bases.
+ * Error messages start with the local variable where.
+ */
+static string generateFacetChecks(const Class *cl, string tabs) {
+    ostringstream oss;
+    string converter = getConverter(getBuiltInBase(cl), false);
+
+    for(; cl && !cl->isBuiltIn(); cl = cl->base) {
+        for(map<string, string>::const_iterator it = cl->facets.begin(); it != cl->facets.end(); it++) {
+            string facet = it->first;
+            string limit = facet == "pattern" ? quotePythonUnicode(it->second) : quotePython(it->second);
+            string condition;
+
+            if(facet == "pattern") {
+                condition = "not _" + cl->getClassname() + "_pattern.match(" + (converter == "str" ? "value" : "str(value)") + ")";
+            } else if(facet == "length" || facet == "minLength" || facet == "maxLength" || facet == "totalDigits") {
+                string op = facet == "length" ? " != " : facet == "minLength" ? " < " : " > ";
+                condition = (facet == "totalDigits" ? "totalDigits(value)" : "len(value)") + op + it->second;
+            } else {
+                string op = facet == "minInclusive" ? " < " : facet == "maxInclusive" ? " > " : facet == "minExclusive" ? " <= " : " >= ";
+                condition = "value" + op + (isIntegerLiteral(it->second) ? it->second : converter == "str" ? limit : converter + "(" + limit + ")");
+            }
+
+            oss << tabs << "if " << condition << ":" << endl;
+            oss << tabs << t << "raise ValueError(\"%s: %r breaks " << facet << " %s\" % (where, value, " << limit << "))" << endl;
+        }
+    }
+
+    //empty elements have None content when bound through minidom
+    if(!oss.str().empty() && (converter == "str" || converter == "strToHex"))
+        return tabs + "if value == None:\n" + tabs + t + "value = \"\"\n" + oss.str();
+
+    return oss.str();
+}
+
+/**
+ * Writes the module level regular expressions used by generateFacetChecks() for cl and its simple bases.
+ */
+static void writeFacetPatterns(ostream& os, const Class *cl) {
+    for(; cl && !cl->isBuiltIn(); cl = cl->base) {
+        map<string, string>::const_iterator it = cl->facets.find("pattern");
+
+        if(it != cl->facets.end())
+            os << "_" << cl->getClassname() << "_pattern = re.compile(" << quotePythonUnicode("(?:" + it->second + ")\\Z") << ", re.UNICODE)" << endl;
+    }
+}
+
+string Class::generateValidator() const {
+    ostringstream oss;
+    string className = getClassname();
+
+    if(isSimple()) {
+        string checks = generateFacetChecks(this, t + t);
+
+        if(!enumerations.empty()) {
+            checks += t + t + "if value not in cls.values:\n";
+            checks += t + t + t + "raise ValueError(\"%s: %r is not a valid " + className + "\" % (where, value))\n";
+        }
+
+        oss << t << endl;
+        oss << t << "@classmethod" << endl;
+        oss << t << "def check_value(cls, value, where = \"" << className << "\"):" << endl;
+        oss << (checks.empty() ? t + t + "pass\n" : checks);
+        oss << t << endl;
+        oss << t << "def validate(self, where = \"" << className << "\"):" << endl;
+        oss << t << t << "self.check_value(self.content, where)" << endl;
+
+        return oss.str();
+    }
+
+    ostringstream body;
+
+    if(base && !base->isSimple()) {
+        body << t << t << base->getClassname() << ".validate(self, where)" << endl;
+    } else if(base) {
+        //simpleContent
+        string checks = generateFacetChecks(base, t + t);
+
+        if(!checks.empty())
+            body << t << t << "value = self.content" << endl << checks;
+    }
+
+    for(list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
+        if(!it->cl)
+            continue;
+
+        string member = "self." + it->name;
+        string path = "where + \"." + it->name + "\"";
+        string type = it->cl->getClassname();
+
+        //occurrences
+        if(it->isArray()) {
+            if(it->minOccurs > 0) {
+                body << t << t << "if len(" << member << ") < " << it->minOccurs << ":" << endl;
+                body << t << t << t << "raise ValueError(\"%s: %d " << it->name << ", expected at least " << it->minOccurs << "\" % (where, len(" << member << ")))" << endl;
+            }
+
+            if(it->maxOccurs != UNBOUNDED) {
+                body << t << t << "if len(" << member << ") > " << it->maxOccurs << ":" << endl;
+                body << t << t << t << "raise ValueError(\"%s: %d " << it->name << ", expected at most " << it->maxOccurs << "\" % (where, len(" << member << ")))" << endl;
+            }
+        } else if(it->minOccurs > 0) {
+            body << t << t << "if " << member << " == None:" << endl;
+            body << t << t << t << "raise ValueError(\"%s: missing " << it->name << "\" % where)" << endl;
+        }
+
+        //values. attributes of simple types other than enumerations are kept as strings
+        if(it->cl->isSimple() && !hasFacets(it->cl))
+            continue;
+
+        if(it->isArray()) {
+            body << t << t << "path = " << path << endl;
+            body << t << t << "for value in " << member << ":" << endl;
+
+            if(it->cl->isSimple())
+                body << t << t << t << type << ".check_value(value.content, path)" << endl;
+            else
+                body << t << t << t << "value.validate(path)" << endl;
+        } else {
+            body << t << t << "if " << member << " != None:" << endl;
+
+            if(!it->cl->isSimple())
+                body << t << t << t << member << ".validate(" << path << ")" << endl;
+            else if(it->isAttribute && it->cl->enumerations.empty())
+                body << t << t << t << type << ".check_value(" << type << ".from_value(" << member << ").content, " << path << ")" << endl;
+            else
+                body << t << t << t << type << ".check_value(" << member << ".content, " << path << ")" << endl;
+        }
+    }
+
+    oss << t << endl;
+    oss << t << "def validate(self, where = \"" << className << "\"):" << endl;
+    oss << (body.str().empty() ? t + t + "pass\n" : body.str());
+
+    return oss.str();
+}
+
+string Class::generateEnumerationMethods() const {
+    ostringstream oss;
+    string className = getClassname();
+
+    //members normally share the constants, but copies made by pickle on Python 2 still compare equal
+    oss << t << endl;
+    oss << t << "def __eq__(self, other):" << endl;
+    oss << t << t << "return isinstance(other, " << className << ") and self.content == other.content" << endl;
+    oss << t << endl;
+    oss << t << "def __ne__(self, other):" << endl;
+    oss << t << t << "return not self == other" << endl;
+    oss << t << endl;
+    oss << t << "def __hash__(self):" << endl;
+    oss << t << t << "return hash(self.content)" << endl;
+    oss << t << endl;
+    oss << t << "def __reduce__(self):" << endl;
+    oss << t << t << "return (" << className << ".from_value, (self.content,))" << endl;
+
+    oss << t << endl;
+    oss << t << "@classmethod" << endl;
+    oss << t << "def from_value(cls, value):" << endl;
+    oss << t << t << "try:" << endl;
+    oss << t << t << t << "return cls.values[value]" << endl;
+    oss << t << t << "except (KeyError, TypeError):" << endl;
+    oss << t << t << t << "raise ValueError(\"%r is not a valid " << className << "\" % (value,))" << endl;
+
+    return oss.str();
+}
+
+void Class::writeEnumerationConstants(ostream& os) const {
+    string className = getClassname();
+    string converter = getConverter(getBuiltInBase(this), false);
+    string values;
+
+    for(list<pair<string, string> >::const_iterator it = enumerations.begin(); it != enumerations.end(); it++) {
+        string constant = className + "." + it->second;
+        string value = quotePython(it->first);
+
+        os << constant << " = " << className << "(" << (converter == "str" ? value : converter + "(" + value + ")") << ")" << endl;
+        values += (it == enumerations.begin() ? "" : ", ") + value + ": " + constant;
+    }
+
+    os << className << ".values = {" << values << "}" << endl;
+
+    //the content of non-string types finds its constant too, which is what from_dict() gets
+    if(converter != "str")
+        os << className << ".values.update([(constant.content, constant) for constant in list(" << className << ".values.values())])" << endl;
+}
+
+string Class::generateExpatTables() const {
+    ostringstream oss;
+
+    oss << t << endl;
+    oss << t << "@classmethod" << endl;
+    oss << t << "def expat_tables(cls):" << endl;
+    oss << t << t << "if \"_expat_tables\" not in cls.__dict__:" << endl;
+
+    if(base && !base->isSimple()) {
+        //start out with copies of the tables of our base
+        oss << t << t << t << "elements, attributes, content = " << base->getClassname() << ".expat_tables()" << endl;
+        oss << t << t << t << "elements = dict(elements)" << endl;
+        oss << t << t << t << "attributes = dict(attributes)" << endl;
+    } else {
+        oss << t << t << t << "elements = {}" << endl;
+        oss << t << t << t << "attributes = {}" << endl;
+
+        //simpleContent
+        if(base)
+            oss << t << t << t << "content = " << getContentConverter(base) << endl;
+        else
+            oss << t << t << t << "content = None" << endl;
+    }
+
+    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
+        if (!it->cl)
+            continue;
+
+        string isArray = it->isArray() ? "True" : "False";
+
+        if(it->isAttribute) {
+            oss << t << t << t << "attributes[\"" << it->name << "\"] = (\"" << it->name << "\", " << getMemberConverter(*it) << ")" << endl;
+        } else if(it->cl->isBuiltIn()) {
+            oss << t << t << t << "elements[\"" << it->name << "\"] = (\"" << it->name << "\", " << isArray << ", " << getMemberConverter(*it) << ", None)" << endl;
+        } else if(it->cl->isSimple()) {
+            oss << t << t << t << "elements[\"" << it->name << "\"] = (\"" << it->name << "\", " << isArray << ", " << it->cl->getClassname() << ".from_value, None)" << endl;
+        } else {
+            oss << t << t << t << "elements[\"" << it->name << "\"] = (\"" << it->name << "\", " << isArray << ", None, " << it->cl->getClassname() << ")" << endl;
+        }
+    }
+
+    oss << t << t << t << "cls._expat_tables = (elements, attributes, content)" << endl;
+    oss << t << t << "return cls._expat_tables" << endl;
+
+    return oss.str();
+}
+
+string Class::generateColumnSpecs() const {
+    ostringstream oss;
+
+    oss << t << endl;
+    oss << t << "@classmethod" << endl;
+    oss << t << "def column_specs(cls):" << endl;
+    oss << t << t << "if \"_column_specs\" not in cls.__dict__:" << endl;
+
+    if(base && !base->isSimple())
+        oss << t << t << t << "specs = list(" << base->getClassname() << ".column_specs())" << endl;
+    else {
+        oss << t << t << t << "specs = []" << endl;
+
+        //simpleContent
+        if(base) {
+            string converter = getContentConverter(base);
+            oss << t << t << t << "specs.append((\"content\", None, \"" << getColumnTypecode(base, converter, true) << "\", " << converter << "))" << endl;
+        }
+    }
+
+    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
+        if(!it->cl || it->isArray() || !(it->cl->isBuiltIn() || it->cl->isSimple()))
+            continue;
+
+        string converter = getColumnConverter(*it);
+
+        oss << t << t << t << "specs.append((\"" << it->name << "\", " << (it->isAttribute ? "True" : "False") << ", \"";
+        oss << getColumnTypecode(it->cl, converter, it->isRequired()) << "\", " << converter << "))" << endl;
+    }
+
+    oss << t << t << t << "cls._column_specs = tuple(specs)" << endl;
+    oss << t << t << "return cls._column_specs" << endl;
+
+    return oss.str();
+}
+
+/**
+ * Writes the code binding the child elements and attributes of the DOM node in the variable of the given depth
+ * into the object in the variable of that depth, the way parse_node() of cl would.
+ * Complex children are bound by nested copies of this code down to --inline-depth, except for the classes
+ * already being inlined (recursive types) and simpleContent, which are bound by their fromNode().
+ * The names of the classes the code refers to are added to classesUsed.
+ */
+static void writeInlineBinding(ostream& oss, const Class *cl, int depth, const string& tabs, vector<const Class*>& inlining, set<string>& classesUsed) {
+    list<Class::Member> attributes, elements;
+    getChainMembers(cl, attributes, elements);
+
+    ostringstream level, next;
+    level << depth;
+    next << depth + 1;
+
+    string nodeVar = depth ? "child" + level.str() : "node";
+    string objVar = depth ? "obj" + level.str() : "self";
+    string childVar = "child" + next.str();
+    string nameVar = "name" + next.str();
+
+    for(const Class *c = cl; c && !c->isSimple(); c = c->base)
+        inlining.push_back(c);
+
+    if(!elements.empty()) {
+        oss << tabs << "for " << childVar << " in " << nodeVar << ".childNodes:" << endl;
+        oss << tabs << t << "if " << childVar << ".nodeType != Node.ELEMENT_NODE:" << endl;
+        oss << tabs << t << t << "continue" << endl;
+        oss << tabs << t << nameVar << " = " << childVar << ".localName" << endl;
+    }
+
+    bool first = true;
+
+    for(list<Class::Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        string et = tabs + t + t;
+        string converter = getMemberConverter(*it);
+        string value;
+
+        oss << tabs << t << (first ? "if " : "elif ") << nameVar << " == \"" << it->name << "\":" << endl;
+        first = false;
+
+        if(!converter.empty())
+            value = converter + "(getText(" + childVar + "))";
+        else {
+            const Class *child = it->cl;
+            list<Class::Member> childAttributes, childElements;
+
+            classesUsed.insert(child->getClassname());
+
+            if(depth + 1 > inlineDepth || child->isSimple() || getChainMembers(child, childAttributes, childElements) ||
+               find(inlining.begin(), inlining.end(), child) != inlining.end())
+                value = child->getClassname() + ".fromNode(" + childVar + ")";
+            else {
+                value = "obj" + next.str();
+                oss << et << value << " = " << child->getClassname() << "()" << endl;
+                writeInlineBinding(oss, child, depth + 1, et, inlining, classesUsed);
+
+                //the parse_node() of the child, which counts its elements, isn't called
+                if(useInstrument)
+                    oss << et << "countInlined(" << child->getClassname() << ", " << childVar << ")" << endl;
+            }
+        }
+
+        oss << et << objVar << "." << it->name << (it->isArray() ? ".append(" + value + ")" : " = " + value) << endl;
+    }
+
+    for(list<Class::Member>::const_iterator it = attributes.begin(); it != attributes.end(); it++) {
+        //enumerated attributes are converted by the from_value() of their class
+        if(!it->cl->isBuiltIn() && !it->cl->enumerations.empty())
+            classesUsed.insert(it->cl->getClassname());
+
+        oss << tabs << "if " << nodeVar << ".hasAttribute(\"" << it->name << "\"):" << endl;
+        oss << tabs << t << objVar << "." << it->name << " = " << getMemberConverter(*it) << "(" << nodeVar << ".getAttribute(\"" << it->name << "\"))" << endl;
+    }
+
+    for(const Class *c = cl; c && !c->isSimple(); c = c->base)
+        inlining.pop_back();
+}
+
+string Class::generateInlineParser(set<string>& classesUsed) const {
+    ostringstream oss;
+    vector<const Class*> inlining;
+
+    oss << t << endl;
+    oss << t << "def parse_node(self, node):" << endl;
+    oss << t << t << "pass" << endl;
+
+    writeInlineBinding(oss, this, 0, t+t, inlining, classesUsed);
+
+    return oss.str();
+}
+
+string Class::generateMemberSetter(string memberName, string nodeName, string tabs) const {
+    if(isSimple() && base)
+        return base->generateMemberSetter(memberName, nodeName, tabs);
+
+    ostringstream oss;
+
+    oss << tabs << memberName << ".parse_node(node);" << endl;
+
+    return oss.str();
+}
+
+string Class::getClassname() const {
+    return name.second;
+}
+
+void Class::writeImplementation(ostream& os) const {
+    ClassName className = name.second;
+    
+    os << "from JamesXMLObject import *" << endl;
+
+    
+    // Create class with inheritance
+    if(isDocument) {
+        os << "from " << base->getClassname() << " import *" << endl << endl;
+        os << "class " << className << "(" << base->getClassname() << ", JamesXMLObject):";
+    } else if(base && !base->isSimple()) {
+        os << "from " << base->getClassname() << " import *" << endl << endl;
+        os << "class " << className << "(" << base->getClassname() << "):";
+    } else {
+        os << endl << "class " << className << "(JamesXMLObject):";
+    }
+    
+    //not much implementation needed for simple types
+    if(isSimple()) {
+        os << t << endl;
+        os << t << "def __init__(self, content = None):" << endl;
+        os << t << t << "self.content = content" << endl;
+        os << t << endl;
+        os << t << "def __str__(self):" << endl;
+        os << t << t << "return str(self.content)" << endl;
+
+        if(enumerations.empty()) {
+            os << t << endl;
+            os << t << "@classmethod" << endl;
+            os << t << "def from_value(cls, value):" << endl;
+            os << t << t << "return cls(" << getContentConverter(this) << "(value))" << endl;
+        } else
+            os << generateEnumerationMethods();
+    } else {
+        // Create constructor
+        os << t << endl;
+        constructors.back().writeBody(os);
+    
+    }
+    //Factory methods
+    //suffix of the parsexml/parsebytes variant of the chosen backend
+    string backend = useNative ? "_native" : useExpat ? "_expat" : "";
+
+    os << t << endl;
+    os << t << "@classmethod" << endl;
+    os << t << "def fromNode(cls, node):" << endl;
+
+    if(enumerations.empty()) {
+        os << t << t << "obj = cls()" << endl;
+        os << t << t << "obj.parse_node(node)" << endl;
+        os << t << t << "return obj" << endl;
+    } else
+        os << t << t << "return cls.from_value(getText(node))" << endl;
+
+    os << t << endl;
+    os << t << "@classmethod" << endl;
+    if(isSimple()) {
+        os << t << "def fromxml(cls, filename):" << endl;
+        os << t << t << "obj = cls()" << endl;
+        os << t << t << "obj.parsexml" << backend << "(filename)" << endl;
+
+        if(useValidation)
+            os << t << t << "obj.validate()" << endl;
+    } else {
+        //fields selects the members to bind, see getProjection()
+        os << t << "def fromxml(cls, filename, fields = None):" << endl;
+        os << t << t << "obj = cls()" << endl;
+        os << t << t << "if fields != None:" << endl;
+        os << t << t << t << "obj.parsexml_projected(filename, fields)" << endl;
+        os << t << t << "else:" << endl;
+        os << t << t << t << "obj.parsexml" << backend << "(filename)" << endl;
+
+        //projected documents lack the members that weren't asked for
+        if(useValidation)
+            os << t << t << t << "obj.validate()" << endl;
+    }
+    os << t << t << "return obj" << endl;
+
+    //bytes, bytearray, memoryview or mmap
+    os << t << endl;
+    os << t << "@classmethod" << endl;
+    os << t << "def from_bytes(cls, data):" << endl;
+    os << t << t << "obj = cls()" << endl;
+    os << t << t << "obj.parsebytes" << backend << "(data)" << endl;
+
+    if(useValidation)
+        os << t << t << "obj.validate()" << endl;
+
+    os << t << t << "return obj" << endl;
+
+    //documents arriving a piece at a time, see IncrementalParser
+    if(isDocument) {
+        os << t << endl;
+        os << t << "@classmethod" << endl;
+        os << t << "def incremental_parser(cls):" << endl;
+        os << t << t << "return IncrementalParser(cls()" << (useValidation ? ", True" : "") << ")" << endl;
+    }
+
+    //documents whose root holds an array of complex elements can be split at the items of the first such array
+    if(isDocument) {
+        list<Member> attributes, elements;
+        getChainMembers(this, attributes, elements);
+
+        for(list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+            if(it->isArray() && !it->cl->isSimple()) {
+                os << t << endl;
+                os << t << "@classmethod" << endl;
+                os << t << "def fromxml_parallel(cls, filename, workers = None):" << endl;
+                os << t << t << "obj = cls()" << endl;
+                os << t << t << "obj.parsexml_parallel(filename, \"" << it->name << "\", workers)" << endl;
+
+                if(useValidation)
+                    os << t << t << "obj.validate()" << endl;
+
+                os << t << t << "return obj" << endl;
+                break;
+            }
+        }
+    }
+
+    //get_name()
+    os << t << endl;
+    os << t << "def " << "get_name(self):" << endl;
+    os << t << t <<"return \"" << className << "\"" << endl;
+
+    //get_namespace()
+    os << t << endl;
+    os << t << "def " << "get_namespace(self):" << endl;
+    os << t << t <<"return \"" << name.first << "\"" << endl;
+
+    //append_children()
+    os << generateAppender();
+
+    //write_xml()
+    if(!isSimple())
+        os << generateWriter();
+
+    //assignments mark the object and the objects above it as changed, see setTracked()
+    if(useDirty && enumerations.empty()) {
+        os << t << endl;
+        os << t << "_tracked = True" << endl;
+        os << t << "__setattr__ = setTracked" << endl;
+
+        if(!isSimple()) {
+            os << t << "write_xml = writeCached" << endl;
+            os << t << "toxml = toxmlCached" << endl;
+        }
+    }
+
+    //parse_node()
+    if(useLazy && hasComplexElements())
+        os << t << endl << t << "__getattr__ = bindLazy" << endl;
+
+    //parse_node() binds the members of the whole base chain, so it needs the classes of the members of the bases too
+    list<Member> chainAttributes, chainElements;
+    const Class *chainContent = getChainMembers(this, chainAttributes, chainElements);
+    set<string> parserClasses;
+
+    chainElements.splice(chainElements.end(), chainAttributes);
+
+    for(list<Member>::const_iterator it = chainElements.begin(); it != chainElements.end(); it++)
+        if(!it->cl->isBuiltIn())
+            parserClasses.insert(it->cl->getClassname());
+
+    //one flattened parse_node() for the whole document, down to --inline-depth
+    if(isDocument && inlineDepth > 0 && !useLazy && !chainContent)
+        os << generateInlineParser(parserClasses);
+    else
+        os << generateParser();
+
+    //expat_tables()
+    if(!isSimple())
+        os << generateExpatTables();
+
+    //column_specs()
+    if(!isSimple())
+        os << generateColumnSpecs();
+
+    //to_dict(), from_dict() and parse_dict()
+    if(!isSimple())
+        os << generateDictMethods();
+
+    //__getstate__() and __setstate__()
+    os << generateStateMethods();
+
+    //validate() and check_value()
+    os << generateValidator();
+
+    os << endl;
+
+    //precompiled patterns of the facets checked by validate()
+    if(isSimple())
+        writeFacetPatterns(os, this);
+    else if(base && base->isSimple())
+        writeFacetPatterns(os, base);
+
+    if(!enumerations.empty()) {
+        writeEnumerationConstants(os);
+        os << endl;
+    }
+
+    set<string> classesToInclude = getIncludedClasses();
+    for(set<string>::const_iterator it = classesToInclude.begin(); it != classesToInclude.end(); it++)
+        os << "from " << *it << " import *" << endl;
+
+    set<string> classesToPrototype = getPrototypeClasses();
+    for(set<string>::const_iterator it = classesToPrototype.begin(); it != classesToPrototype.end(); it++)
+        if(*it != className)
+            os << "from " << *it << " import *" << endl;
+
+    for(set<string>::const_iterator it = parserClasses.begin(); it != parserClasses.end(); it++)
+        if(*it != className && !(base && *it == base->getClassname()) && !classesToInclude.count(*it) && !classesToPrototype.count(*it))
+            os << "from " << *it << " import *" << endl;
+
+    //let the extension module instantiate this class
+    if(useNative)
+        os << endl << "registerNative(" << className << ")" << endl;
+
+    //count what the objects of this class do, see snapshotCounters()
+    if(useInstrument)
+        os << endl << "instrument(" << className << ")" << endl;
+}
+
+void Class::writeNativeTable(ostream& os, ostream& infos) const {
+    list<Member> attributes, elements;
+    const Class *cl = getChainMembers(this, attributes, elements);
+
+    //attributes are written in the same order as write_xml() writes them
+    map<string, Member> sortedAttributes;
+
+    for(list<Member>::const_iterator it = attributes.begin(); it != attributes.end(); it++)
+        sortedAttributes[it->name] = *it;
+
+    os << "static const Member " << getClassname() << "_members[] = {" << endl;
+
+    for(map<string, Member>::const_iterator it = sortedAttributes.begin(); it != sortedAttributes.end(); it++) {
+        os << t << "{\"" << it->first << "\", true, false, ";
+
+        if(it->second.cl->enumerations.empty())
+            os << getNativeKind(getMemberConverter(it->second)) << ", NULL}," << endl;
+        else
+            os << "SIMPLE, \"" << it->second.cl->getClassname() << "\"}," << endl;
+    }
+
+    for(list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        os << t << "{\"" << it->name << "\", false, " << (it->isArray() ? "true" : "false") << ", ";
+
+        if(it->cl->isBuiltIn())
+            os << getNativeKind(getMemberConverter(*it)) << ", NULL}," << endl;
+        else
+            os << (it->cl->isSimple() ? "SIMPLE" : "COMPLEX") << ", \"" << it->cl->getClassname() << "\"}," << endl;
+    }
+
+    os << t << "{NULL, false, false, NONE, NULL}," << endl;
+    os << "};" << endl << endl;
+
+    infos << t << "{\"" << getClassname() << "\", " << (cl ? getNativeKind(getContentConverter(cl)) : "NONE") << ", " << getClassname() << "_members}," << endl;
+}
+
+/**
+ * Escapes the characters of str that can't appear as such in attribute values or text.
+ */
+static string escapeXML(const string& str) {
+    string ret;
+
+    for(string::const_iterator it = str.begin(); it != str.end(); it++) {
+        switch(*it) {
+        case '&': ret += "&amp;"; break;
+        case '<': ret += "&lt;"; break;
+        case '>': ret += "&gt;"; break;
+        case '"': ret += "&quot;"; break;
+        default: ret += *it;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Returns how many items of member to write in a sample document, within the bounds of both the schema and options.
+ */
+static int getSampleCount(const Class::Member& member, const SampleOptions& options, int depth) {
+    if(member.isRequired())
+        return 1;
+
+    if(depth >= options.maxDepth)
+        return member.minOccurs;
+
+    if(member.isOptional())
+        return options.randomInt(0, 1);
+
+    int low = min(max(member.minOccurs, options.minOccurs), member.maxOccurs);
+    int high = min(member.maxOccurs, options.maxOccurs);
+
+    return options.randomInt(low, max(low, high));
+}
+
+void Class::writeSample(ostream& os, string elementName, string nameSpace, const SampleOptions& options, int depth) const {
+    list<Member> attributes, elements;
+    const Class *content = getChainMembers(this, attributes, elements);
+
+    os << "<" << elementName;
+
+    if(!nameSpace.empty())
+        os << " xmlns=\"" << escapeXML(nameSpace) << "\"";
+
+    for(list<Member>::const_iterator it = attributes.begin(); it != attributes.end(); it++)
+        if(getSampleCount(*it, options, depth))
+            os << " " << it->name << "=\"" << escapeXML(it->cl->generateSampleValue(options)) << "\"";
+
+    os << ">";
+
+    if(content)
+        os << escapeXML(content->generateSampleValue(options));
+
+    for(list<Member>::const_iterator it = elements.begin(); it != elements.end(); it++) {
+        for(int x = getSampleCount(*it, options, depth); x > 0; x--) {
+            if(it->cl->isSimple())
+                os << "<" << it->name << ">" << escapeXML(it->cl->generateSampleValue(options)) << "</" << it->name << ">";
+            else
+                it->cl->writeSample(os, it->name, "", options, depth + 1);
+        }
+    }
+
+    os << "</" << elementName << ">";
+}
+
+/**
+ * A character class of a pattern that sample characters are picked from.
+ */
+class SampleCharClass {
+public:
+    vector<pair<unsigned, unsigned> > ranges;
+    bool nonDigits;     //\D
+    bool negated;
+
+    SampleCharClass() : nonDigits(false), negated(false) {
+    }
+
+    bool contains(unsigned c) const {
+        bool found = nonDigits && (c < '0' || c > '9');
+
+        for(size_t x = 0; x < ranges.size() && !found; x++)
+            found = c >= ranges[x].first && c <= ranges[x].second;
+
+        return found != negated;
+    }
+};
+
+/**
+ * Reads the character or escape at pos of a Python regular expression written by translatePattern() in main.cpp.
+ * Returns false if it was \d or \D, which are added to cls instead.
+ */
+static bool readPatternChar(const string& pattern, size_t& pos, unsigned& c, SampleCharClass& cls) {
+    if(pattern[pos] != '\\') {
+        c = readUTF8(pattern, pos);
+        return true;
+    }
+
+    c = (unsigned char)pattern[pos + 1];
+    pos += 2;
+
+    if(c == 'd') {
+        cls.ranges.push_back(make_pair((unsigned)'0', (unsigned)'9'));
+        return false;
+    } else if(c == 'D') {
+        cls.nonDigits = true;
+        return false;
+    } else if(c == 'n' || c == 'r' || c == 't') {
+        c = c == 'n' ? '\n' : c == 'r' ? '\r' : '\t';
+    } else if(c == 'x') {
+        c = strtoul(pattern.substr(pos, 2).c_str(), NULL, 16);
+        pos += 2;
+    }
+
+    return true;
+}
+
+/**
+ * Reads the character class at pos of a translated pattern, the [ already read.
+ */
+static bool readPatternClass(const string& pattern, size_t& pos, SampleCharClass& cls) {
+    if(pos < pattern.size() && pattern[pos] == '^') {
+        cls.negated = true;
+        pos++;
+    }
+
+    while(pos < pattern.size() && pattern[pos] != ']') {
+        unsigned from, to;
+
+        if(!readPatternChar(pattern, pos, from, cls))
+            continue;
+
+        to = from;
+
+        //translatePattern() escapes every - that doesn't make a range
+        if(pos < pattern.size() && pattern[pos] == '-' && (++pos >= pattern.size() || !readPatternChar(pattern, pos, to, cls)))
+            return false;
+
+        cls.ranges.push_back(make_pair(from, to));
+    }
+
+    return pos++ < pattern.size();
+}
 
-    /* nop statement to handle a node with no children */
-    oss << t << t << "pass" << endl;
+/**
+ * Picks a random character of cls that isn't in excluded and can be written in XML without being normalized away.
+ * Negated classes pick among letters, digits and a few punctuation characters.
+ */
+static bool pickPatternChar(const SampleCharClass& cls, const SampleCharClass *excluded, const SampleOptions& options, unsigned& c) {
+    vector<pair<unsigned, unsigned> > ranges = cls.ranges;
 
-    if(base) {
-        if(base->isSimple()) {
-            //simpleContent
-            oss << t << t << "tmpText = document.createTextNode(str(self.content))" << endl;
-            oss << t << t << "node.appendChild(tmpText)" << endl;
-        } else {
-            //call base appender
-            oss << t << t << base->getClassname() << ".append_children(self, node, document);" << endl;
-        }
-    } 
-    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
-        if (!it->cl)
-            continue;
+    if(cls.negated) {
+        const char *characters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.:";
 
-        string name = it->name;
-        string setterName = it->name;
-        string nodeName = name + "Node";
-        string et = t+t; // Extra tabs
-        string subName = "self." + name;
+        ranges.clear();
 
-        if(it != members.begin())
-            oss << endl;
+        for(const char *p = characters; *p; p++)
+            if(cls.contains(*p))
+                ranges.push_back(make_pair((unsigned)*p, (unsigned)*p));
+    } else if(cls.nonDigits) {
+        ranges.push_back(make_pair((unsigned)'a', (unsigned)'z'));
+        ranges.push_back(make_pair((unsigned)'A', (unsigned)'Z'));
+    }
 
-        if(it->isOptional()) {
-            oss << et << "if self." << name << " != None:" << endl;
-            et = et + t;
-        }
-        if(it->isArray()) {
-            oss << et << "if len(self." << name << ") > 0:" << endl;
-            et = et + t;
-            oss << et << "for value in self." << name << ":" << endl;
-            subName = "value";
-            et = et + t;
-        } 
-           
-        if(it->isAttribute) {
-            //attribute
-            oss << it->cl->generateAttributeSetter(name, subName, et);
-        } else {
-            //element
-            oss << it->cl->generateElementSetter(subName, name, et);
-        }
+    for(int tries = 0; tries < 64 && !ranges.empty(); tries++) {
+        const pair<unsigned, unsigned>& range = ranges[options.randomInt(0, ranges.size() - 1)];
+        c = range.first + options.randomInt(0, range.second - range.first);
+
+        if(c >= 0x20 && (c < 0xD800 || c > 0xDFFF) && c < 0xFFFE && !(excluded && excluded->contains(c)))
+            return true;
     }
 
-    return oss.str();
+    return false;
 }
 
-string Class::generateElementSetter(string memberName, string nodeName, string tabs) const {
-    ostringstream oss;
-    if(isSimple() && base)
-        return base->generateElementSetter(memberName, nodeName, tabs);
+static bool samplePatternAlternatives(const string& pattern, size_t& pos, const SampleOptions& options, string& out);
 
-    oss << tabs << "tmp = document.createElement(\"" << nodeName << "\")" << endl;
-    oss << tabs << "node.appendChild(tmp)" << endl;
-    oss << tabs << memberName << ".append_children(tmp, document)" << endl;
-    return oss.str();
-}
+/**
+ * Appends a random match of the atom at pos of a translated pattern to out.
+ * Returns false if the pattern can't be sampled, like subtractions of subtractions.
+ */
+static bool samplePatternAtom(const string& pattern, size_t& pos, const SampleOptions& options, string& out) {
+    SampleCharClass cls, subtracted;
+    bool isSubtraction = false;
+    unsigned c;
 
-string Class::generateAttributeSetter(string memberName, string attributeName, string tabs) const {
-    if(isSimple() && base)
-        return base->generateAttributeSetter(memberName, attributeName, tabs);
+    if(pattern.compare(pos, 6, "(?:(?!") == 0 && pattern.compare(pos + 6, 1, "[") == 0) {
+        //[a-z-[aeiou]] was translated into (?:(?![aeiou])[a-z])
+        pos += 7;
 
-    throw runtime_error("Tried to generateAttributeSetter() for a non-simple Class");
+        if(!readPatternClass(pattern, pos, subtracted) || pattern.compare(pos, 2, ")[") != 0)
+            return false;
+
+        pos += 2;
+
+        if(!readPatternClass(pattern, pos, cls) || pattern.compare(pos, 1, ")") != 0)
+            return false;
+
+        pos++;
+        isSubtraction = true;
+    } else if(pattern.compare(pos, 3, "(?:") == 0) {
+        pos += 3;
+
+        if(!samplePatternAlternatives(pattern, pos, options, out) || pos >= pattern.size())
+            return false;
+
+        pos++;
+        return true;
+    } else if(pattern[pos] == '(') {
+        return false;
+    } else if(pattern[pos] == '[') {
+        pos++;
+
+        if(!readPatternClass(pattern, pos, cls))
+            return false;
+    } else if(readPatternChar(pattern, pos, c, cls)) {
+        appendUTF8(out, c);
+        return true;
+    }
+
+    if(!pickPatternChar(cls, isSubtraction ? &subtracted : NULL, options, c))
+        return false;
+
+    appendUTF8(out, c);
+    return true;
 }
 
-string Class::generateParser() const {
-    ostringstream oss;
-    string childName = "child" + variablePostfix;
-    string nameName = "name" + variablePostfix;
+/**
+ * Reads the quantifier at pos of a translated pattern, if any, and sets count to a random number of repetitions within it.
+ * Open-ended quantifiers repeat within the --sample-string-length range.
+ */
+static void readPatternQuantifier(const string& pattern, size_t& pos, const SampleOptions& options, int& count) {
+    int low = 1, high = 1;
 
-    oss << t << endl;
-    oss << t << "def parse_node(self, node):" << endl;
+    if(pos >= pattern.size() || !strchr("?*+{", pattern[pos])) {
+        count = 1;
+        return;
+    }
 
-    if(base) {
-        if(base->isSimple()) {
-            //simpleContent
-            oss << base->generateMemberSetter("self.content", "content", t+t) << endl;
-        } else {
-            oss << t << t << base->getClassname() << ".parse_node(self, node)" << endl;
-        }
+    char quantifier = pattern[pos++];
+
+    if(quantifier == '?') {
+        count = options.randomInt(0, 1);
+        return;
+    } else if(quantifier == '*' || quantifier == '+') {
+        low = quantifier == '+';
+        high = -1;
+    } else {
+        //{n}, {n,} or {n,m}, checked by translatePattern()
+        size_t end = pattern.find('}', pos);
+        string bounds = pattern.substr(pos, end - pos);
+        size_t comma = bounds.find(',');
+
+        low = atoi(bounds.c_str());
+        high = comma == string::npos ? low : comma + 1 == bounds.size() ? -1 : atoi(bounds.c_str() + comma + 1);
+        pos = end + 1;
     }
-    
-    oss << endl;
-    oss << t << t << "for childNode in node.childNodes:" << endl;
-    oss << t << t << t << "if childNode.localName == None:" << endl;
-    oss << t << t << t << t << "continue" << endl;
-    oss << endl;
 
-    //TODO: replace this with a map<pair<string, DOMNode::ElementType>, void(*)(DOMNode*)> thing?
-    //in other words, lookin up parsing function pointers in a map should be faster then all these string comparisons
-    bool first = true;
+    int top = high < 0 ? max(low, options.maxStringLength) : min(high, max(low, options.maxStringLength));
+    count = options.randomInt(min(max(low, options.minStringLength), top), top);
+}
 
-    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
-        if (!it->cl)
+/**
+ * Appends a random match of the alternatives at pos of a regular expression written by translatePattern() in main.cpp
+ * to out, reading up to the end of pattern or the ) that closes them.
+ */
+static bool samplePatternAlternatives(const string& pattern, size_t& pos, const SampleOptions& options, string& out) {
+    vector<string> branches(1);
+
+    while(pos < pattern.size() && pattern[pos] != ')') {
+        if(pattern[pos] == '|') {
+            branches.push_back("");
+            pos++;
             continue;
+        }
 
-        if(!it->isAttribute) {
-            if(first)
-                first = false;
-            else
-                oss << endl;
+        size_t start = pos;
+        string atom;
 
-            oss << t << t << t << "if childNode.localName == \"" << it->name << "\" and childNode.nodeType == Node.ELEMENT_NODE:" << endl;
-            
-            oss << t << t << t << t << "self." << it->name;
-            if(it->isArray()) {
-                oss << ".append(";
-            } else {
-                oss << " = ";
-            }
-            string type = it->type.second;
-            if(type == "int" || type == "short" || type == "unsignedShort" || type == "unsignedInt" || type == "byte" || type == "unsignedByte") {
-                oss << "int(childNode.firstChild.nodeValue)";
-            } else if(type == "long" || type == "unsignedLong") {
-                oss << "long(childNode.firstChild.nodeValue)";
-            } else if(type == "float" || type == "double") {
-                oss << "float(childNode.firstChild.nodeValue)";
-            } else if(type == "boolean") {
-                oss << "self.strToBool(childNode.firstChild.nodeValue)";
-            } else if(type == "hexBinary") {
-                oss << "self.strToHex(childNode.firstChild.nodeValue)";
-            } else if(type == "string" || type == "anyURI" || type == "dateTime" || type == "date" || type == "time" || type == "language") {
-                oss << "str(childNode.firstChild.nodeValue)";
-            } else {
-                oss << type << ".fromNode(childNode)";
-            }
+        if(!samplePatternAtom(pattern, pos, options, atom))
+            return false;
 
-            if(it->isArray()) {
-                oss << ")" << endl;
-            } else {
-                oss << endl;
+        int count;
+        readPatternQuantifier(pattern, pos, options, count);
+
+        //each repetition is sampled anew, from the start of the atom
+        for(int x = 0; x < count; x++) {
+            if(x > 0) {
+                size_t again = start;
+                atom.clear();
+                samplePatternAtom(pattern, again, options, atom);
             }
+
+            branches.back() += atom;
         }
     }
 
-    //attributes
-    for(std::list<Member>::const_iterator it = members.begin(); it != members.end(); it++) {
-        if (!it->cl)
-            continue;
+    out += branches[options.randomInt(0, branches.size() - 1)];
+    return true;
+}
 
-        if(it->isAttribute) {
-            oss << t << t << endl;
-            oss << t << t << "if node.hasAttribute(\"" << it->name << "\"):" << endl;
-            oss << t << t << t << "self." << it->name << " = ";
+/**
+ * Returns true if values of the built-in type cl are sampled from patterns.
+ */
+static bool isPatternSampled(const Class *cl) {
+    return cl && (cl->name.second == "string" || cl->name.second == "anyURI" || cl->name.second == "language");
+}
+
+/**
+ * Returns the number of characters of the UTF-8 string str.
+ */
+static int countUTF8(const string& str) {
+    int count = 0;
+
+    for(size_t x = 0; x < str.size(); x++)
+        count += (str[x] & 0xC0) != 0x80;
+
+    return count;
+}
+
+/**
+ * Sets value to a random value of the simple class cl satisfying the range, length and totalDigits facets of cl and its
+ * simple bases, and for strings the most derived pattern. Returns false if it has none of them that apply to its
+ * built-in type, in which case the built-in type writes the value. See Class::hasUnsampledFacets() for what is left out.
+ */
+static bool generateFacetedSample(const Class *cl, const SampleOptions& options, string& value) {
+    const Class *builtIn = getBuiltInBase(cl);
 
-            string type = it->type.second;
-            if(type == "int" || type == "short" || type == "unsignedShort" || type == "unsignedInt" || type == "byte" || type == "unsignedByte") {
-                oss << "int(";
-            } else if(type == "long" || type == "unsignedLong") {
-                oss << "long(";
-            } else if(type == "float" || type == "double") {
-                oss << "float(";
-            } else  {
-                oss << "str(";
-            } 
-            oss << "node.getAttribute(\"" << it->name << "\"))" << endl;
+    if(!builtIn)
+        return false;
+
+    //the ranges BuiltInClass::generateSampleValue() draws from
+    const char *integerTypes[] = {"byte", "unsignedByte", "short", "unsignedShort", "int", "integer", "unsignedInt", "long", "unsignedLong"};
+    const double integerRanges[][2] = {{-128, 127}, {0, 255}, {-32768, 32767}, {0, 65535}, {INT_MIN, INT_MAX}, {INT_MIN, INT_MAX},
+                                       {0, 4294967295.0}, {-1e18 + 1, 1e18 - 1}, {0, 1e19 - 1}};
+    string type = builtIn->name.second, className = cl->getClassname();
+    bool isInteger = false, isReal = type == "float" || type == "double", hasLength = type == "string" || type == "anyURI" || type == "hexBinary";
+    double low = -10000, high = 10000;
+    bool lowOpen = false, highOpen = false, constrained = false;
+    int minLength = 0, maxLength = INT_MAX;
+    const string *pattern = NULL;
+
+    for(size_t x = 0; x < sizeof(integerTypes) / sizeof(const char*); x++) {
+        if(type == integerTypes[x]) {
+            isInteger = true;
+            low = integerRanges[x][0];
+            high = integerRanges[x][1];
         }
     }
 
-    return oss.str();
-}
+    for(; cl && !cl->isBuiltIn(); cl = cl->base) {
+        for(map<string, string>::const_iterator it = cl->facets.begin(); it != cl->facets.end(); it++) {
+            const string& facet = it->first;
+            double limit = strtod(it->second.c_str(), NULL);
+            bool exclusive = facet == "minExclusive" || facet == "maxExclusive";
+
+            if((isInteger || isReal) && (facet == "minInclusive" || facet == "minExclusive")) {
+                if(isInteger)
+                    limit = exclusive ? floor(limit) + 1 : ceil(limit);
+
+                if(limit > low || (limit == low && exclusive && isReal)) {
+                    low = limit;
+                    lowOpen = exclusive && isReal;
+                }
+            } else if((isInteger || isReal) && (facet == "maxInclusive" || facet == "maxExclusive")) {
+                if(isInteger)
+                    limit = exclusive ? ceil(limit) - 1 : floor(limit);
+
+                if(limit < high || (limit == high && exclusive && isReal)) {
+                    high = limit;
+                    highOpen = exclusive && isReal;
+                }
+            } else if(isInteger && facet == "totalDigits") {
+                limit = pow(10.0, atoi(it->second.c_str())) - 1;
+                low = max(low, -limit);
+                high = min(high, limit);
+            } else if(hasLength && (facet == "length" || facet == "minLength")) {
+                minLength = max(minLength, atoi(it->second.c_str()));
+
+                if(facet == "length")
+                    maxLength = min(maxLength, atoi(it->second.c_str()));
+            } else if(hasLength && facet == "maxLength") {
+                maxLength = min(maxLength, atoi(it->second.c_str()));
+            } else if(isPatternSampled(builtIn) && facet == "pattern") {
+                //the patterns of bases are left to chance
+                if(!pattern)
+                    pattern = &it->second;
+            } else
+                continue;
+
+            constrained = true;
+        }
+    }
 
-string Class::generateMemberSetter(string memberName, string nodeName, string tabs) const {
-    if(isSimple() && base)
-        return base->generateMemberSetter(memberName, nodeName, tabs);
+    if(!constrained)
+        return false;
 
-    ostringstream oss;
+    if(low > high || (low == high && (lowOpen || highOpen)) || minLength > maxLength)
+        throw runtime_error("The facets of " + className + " leave no values to sample");
 
-    oss << tabs << memberName << ".parse_node(node);" << endl;
+    ostringstream oss;
 
-    return oss.str();
-}
+    if(pattern) {
+        //lengths aren't known until the pattern has been sampled
+        for(int tries = 0; tries < 100; tries++) {
+            size_t pos = 0;
+            value.clear();
 
-string Class::getClassname() const {
-    return name.second;
-}
+            if(!samplePatternAlternatives(*pattern, pos, options, value))
+                throw runtime_error("The pattern of " + className + " can't be sampled");
 
-void Class::writeImplementation(ostream& os) const {
-    ClassName className = name.second;
-    
-    os << "from JamesXMLObject import *" << endl;
+            if(countUTF8(value) >= minLength && countUTF8(value) <= maxLength)
+                return true;
+        }
 
-    
-    // Create class with inheritance
-    if(isDocument) {
-        os << "from " << base->getClassname() << " import *" << endl << endl;
-        os << "class " << className << "(" << base->getClassname() << ", JamesXMLObject):";
-    } else if(base && !base->isSimple()) {
-        os << "from " << base->getClassname() << " import *" << endl << endl;
-        os << "class " << className << "(" << base->getClassname() << "):";
+        throw runtime_error("Found no sample value of " + className + " matching both its pattern and its length facets");
+    } else if(isInteger) {
+        //+ 0.0 so that zero isn't written as -0
+        oss.setf(ios::fixed);
+        oss.precision(0);
+        oss << min(high, low + floor(options.randomInt(0, INT_MAX) / (INT_MAX + 1.0) * (high - low + 1))) + 0.0;
+    } else if(isReal) {
+        //strictly between low and high if either end is exclusive, with enough digits for them to stay apart
+        double u = (lowOpen || highOpen) ? (options.randomInt(0, INT_MAX - 1) + 1.0) / (INT_MAX + 1.0) : options.randomInt(0, INT_MAX) / (double)INT_MAX;
+        oss.precision(17);
+        oss << low + u * (high - low);
     } else {
-        os << endl << "class " << className << "(JamesXMLObject):";
+        //the --sample-string-length range, moved within the length facets if they don't overlap
+        SampleOptions lengthOptions = options;
+        lengthOptions.minStringLength = min(max(minLength, options.minStringLength), maxLength);
+        lengthOptions.maxStringLength = max(min(maxLength, options.maxStringLength), lengthOptions.minStringLength);
+
+        //anyURI values are written without the usual http://example.com/ prefix, which could break maxLength
+        oss << (type == "hexBinary" ? builtIn->generateSampleValue(lengthOptions) : lengthOptions.randomString());
     }
-    
-    //not much implementation needed for simple types
-    if(isSimple()) {
-        os << t << endl;
-        os << t << "def __init__(self, content = None):" << endl;
-        os << t << t << "self.content = content" << endl;
-        os << t << endl;
-        os << t << "def __str__(self):" << endl;
-        os << t << t << "return str(self.content)" << endl;
-        
-    } else {
-        // Create constructor
-        os << t << endl;
-        constructors.back().writeBody(os);
-    
+
+    value = oss.str();
+    return true;
+}
+
+bool Class::hasUnsampledFacets() const {
+    const Class *builtIn = getBuiltInBase(this);
+    string type = builtIn ? builtIn->name.second : "";
+    bool isDate = type == "date" || type == "time" || type == "dateTime";
+    int patterns = 0;
+
+    //enumerations leave nothing for the other facets to choose
+    for(const Class *cl = this; cl && !cl->isBuiltIn(); cl = cl->base)
+        if(!cl->enumerations.empty())
+            return false;
+
+    for(const Class *cl = this; cl && !cl->isBuiltIn(); cl = cl->base) {
+        for(map<string, string>::const_iterator it = cl->facets.begin(); it != cl->facets.end(); it++) {
+            if(it->first == "pattern") {
+                SampleOptions options;
+                string value;
+                size_t pos = 0;
+
+                if(!isPatternSampled(builtIn) || ++patterns > 1 || !samplePatternAlternatives(it->second, pos, options, value))
+                    return true;
+            } else if(isDate && it->first.find("clusive") != string::npos)
+                return true;
+        }
     }
-    //Factory methods
-    os << t << endl;
-    os << t << "@classmethod" << endl;
-    os << t << "def fromNode(cls, node):" << endl;
-    os << t << t << "obj = cls()" << endl;
-    os << t << t << "obj.parse_node(node)" << endl;
-    os << t << t << "return obj" << endl;
 
-    os << t << endl;
-    os << t << "@classmethod" << endl;
-    os << t << "def fromxml(cls, filename):" << endl;
-    os << t << t << "obj = cls()" << endl;
-    os << t << t << "obj.parsexml(filename)" << endl;
-    os << t << t << "return obj" << endl;
+    return false;
+}
 
-    //get_name()
-    os << t << endl;
-    os << t << "def " << "get_name(self):" << endl;
-    os << t << t <<"return \"" << className << "\"" << endl;
+string Class::generateSampleValue(const SampleOptions& options) const {
+    if(!enumerations.empty()) {
+        list<pair<string, string> >::const_iterator it = enumerations.begin();
+        advance(it, options.randomInt(0, enumerations.size() - 1));
+        return it->first;
+    }
 
-    //get_namespace()
-    os << t << endl;
-    os << t << "def " << "get_namespace(self):" << endl;
-    os << t << t <<"return \"" << name.first << "\"" << endl;
+    if(isSimple() && base) {
+        //the enumerations of a base leave nothing for the other facets to choose
+        for(const Class *cl = base; cl && !cl->isBuiltIn(); cl = cl->base)
+            if(!cl->enumerations.empty())
+                return base->generateSampleValue(options);
 
-    //append_children()
-    os << generateAppender();
+        string value;
 
-    //parse_node()
-    os << generateParser() << endl;
+        if(generateFacetedSample(this, options, value))
+            return value;
 
-    set<string> classesToInclude = getIncludedClasses();
-    for(set<string>::const_iterator it = classesToInclude.begin(); it != classesToInclude.end(); it++)
-        os << "from " << *it << " import *" << endl;
+        return base->generateSampleValue(options);
+    }
 
-    set<string> classesToPrototype = getPrototypeClasses();
-    for(set<string>::const_iterator it = classesToPrototype.begin(); it != classesToPrototype.end(); it++)
-        if(*it != className)
-            os << "from " << *it << " import *" << endl;
+    throw runtime_error("Tried to generateSampleValue() for a non-simple Class");
 }
 
 set<string> Class::getIncludedClasses() const {
@@ -395,6 +1969,17 @@ set<string> Class::getPrototypeClasses() const {
     return classesToPrototype;
 }
 
+bool Class::hasComplexElements() const {
+    for(list<Member>::const_iterator it = members.begin(); it != members.end(); it++)
+        if(it->cl && !it->isAttribute && !it->cl->isSimple())
+            return true;
+
+    return false;
+}
+
+Class::Member::Member() : cl(NULL), minOccurs(1), maxOccurs(1), isAttribute(false), interned(false) {
+}
+
 bool Class::Member::isArray() const {
     return maxOccurs > 1 || maxOccurs == UNBOUNDED;
 }
@@ -415,7 +2000,8 @@ std::list<Class::Member> Class::getElements(bool includeBase, bool vectors, bool
 
     //regard the contents of a complexType with simpleContents as a required
     //element named "content" since we already have that as an element
-    if(base && base->isSimple()) {
+    //simple types derived from other simple types have no arguments of their own, or content would be passed twice
+    if(base && base->isSimple() && !isSimple()) {
         Member contentMember;
         contentMember.name = "content";
         contentMember.cl = base;
@@ -503,8 +2089,45 @@ void Class::Constructor::writeBody(ostream &os) const {
 
            os << t << t << "self." << it->name << " = " << it->name << endl;
         if(it->isArray()) {
+            string typecode = getTypecode(*it);
+
             os << t << t << "if self." << it->name << " == None:" << endl;
-            os << t << t << t << "self." << it->name << " = []" << endl;
+            os << t << t << t << "self." << it->name << " = " << (typecode.empty() ? "[]" : "array(\"" + typecode + "\")") << endl;
         }
     }
 }
+
+SampleOptions::SampleOptions() : minOccurs(0), maxOccurs(5), minStringLength(1), maxStringLength(16), maxDepth(8) {
+}
+
+/**
+ * Returns a random integer in the range [min, max].
+ */
+int SampleOptions::randomInt(int min, int max) const {
+    return (int)floor(min + (double)rand() / ((double)RAND_MAX + 1) * ((double)max - min + 1));
+}
+
+/**
+ * Returns a random alphanumeric string with a length in the range [minStringLength, maxStringLength].
+ */
+string SampleOptions::randomString() const {
+    const char *characters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    string ret;
+
+    for(int x = randomInt(minStringLength, maxStringLength); x > 0; x--)
+        ret += characters[randomInt(0, 61)];
+
+    return ret;
+}
+
+/**
+ * Returns count random decimal digits, the first of which is non-zero.
+ */
+string SampleOptions::randomDigits(int count) const {
+    string ret(1, '1' + randomInt(0, 8));
+
+    for(int x = 1; x < count; x++)
+        ret += '0' + randomInt(0, 9);
+
+    return ret;
+}
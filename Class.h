@@ -41,6 +41,22 @@ extern const std::string tempWithPostfix;       //"temp" + variablePostfix
 extern const std::string convertedWithPostfix;  //"converted" + variablePostfix
 extern const std::string ssWithPostfix;         //"ss" + variablePostfix
 
+/**
+ * Options and random number source for the sample instance documents written by Class::writeSample() (--sample).
+ */
+class SampleOptions {
+public:
+    int minOccurs, maxOccurs;               //number of items in arrays, kept within the bounds given by the schema
+    int minStringLength, maxStringLength;   //length of strings, and of hexBinary values in bytes
+    int maxDepth;                           //below this depth only required members are written, so that recursive types terminate
+
+    SampleOptions();
+
+    int randomInt(int min, int max) const;
+    std::string randomString() const;
+    std::string randomDigits(int count) const;
+};
+
 class Class {
 public:
     class Member {
@@ -51,6 +67,9 @@ public:
         int minOccurs;
         int maxOccurs;
         bool isAttribute;   //true if this member is an attribute rather than an element
+        bool interned;      //true if string values of this member are interned (--intern)
+
+        Member();
 
         bool isArray() const;
         bool isOptional() const;    //returns true if this member is optional (not an array)
@@ -109,6 +128,7 @@ public:
     const ClassType type;
 
     bool isDocument;            //true if this is a document class
+    bool interned;              //true if string values of this type are interned (--intern)
 
     FullName baseType;
     Class *base;
@@ -118,6 +138,13 @@ public:
     std::list<Member> members;
     std::list<FullName> groups; //attributeGroups to add to this class
 
+    //lexical value and Python identifier of each xs:enumeration facet of a simple type, in schema order
+    std::list<std::pair<std::string, std::string> > enumerations;
+
+    //other restriction facets of a simple type by name (minInclusive, maxLength, pattern...), checked by validate()
+    //the pattern is already translated into a Python regular expression, see translatePattern() in main.cpp
+    std::map<std::string, std::string> facets;
+
     Class(FullName name, ClassType type);
     Class(FullName name, ClassType type, FullName baseType);
     virtual ~Class();
@@ -149,21 +176,92 @@ public:
      */
     virtual std::string generateAttributeSetter(std::string memberName, std::string attributeName, std::string tabs) const;
 
+    /**
+     * Should return a code fragment for the write_xml() method, which writes this Class as XML text
+     * straight to a write function without going through minidom.
+     */
+    virtual std::string generateWriter() const;
+
+    /**
+     * Should return a code fragment that writes the value of the named member as an element called nodeName.
+     */
+    virtual std::string generateElementWriter(std::string memberName, std::string nodeName, std::string tabs) const;
+
+    /**
+     * Should return a code fragment that writes the value of the named member as an attribute called attributeName.
+     */
+    virtual std::string generateAttributeWriter(std::string memberName, std::string attributeName, std::string tabs) const;
+
     /**
      * Should return a code fragment that for parsing all the members of this Class.
      */
     virtual std::string generateParser() const;
 
+    /**
+     * Returns a code fragment for the parse_node() of document classes with --inline-depth, which binds
+     * the members of this Class and its bases and those of complex child elements in a single function.
+     * The names of the classes it refers to are added to classesUsed.
+     */
+    std::string generateInlineParser(std::set<std::string>& classesUsed) const;
+
     /**
      * Should return a code fragment that parses the value of a DOMElement into the named member.
      */
     virtual std::string generateMemberSetter(std::string memberName, std::string nodeName, std::string tabs) const;
 
+    /**
+     * Returns a code fragment for the expat_tables() class method, which describes how ExpatBinder
+     * should bind the child elements, attributes and text content of this Class.
+     */
+    std::string generateExpatTables() const;
+
+    /**
+     * Returns a code fragment for the column_specs() class method, which lists the single valued simple members
+     * that to_columns() and iter_columns() turn into columns when this Class is the item type of an array.
+     */
+    std::string generateColumnSpecs() const;
+
+    /**
+     * Returns a code fragment for the to_dict(), from_dict() and parse_dict() methods,
+     * which convert this Class to and from plain dicts, lists and values without going through XML.
+     */
+    std::string generateDictMethods() const;
+
+    /**
+     * Returns a code fragment for the __getstate__() and __setstate__() methods, which pickle
+     * the members of this Class and its bases as a tuple, and the _state_members tuple naming them.
+     */
+    std::string generateStateMethods() const;
+
+    /**
+     * Returns a code fragment for validate(), which checks the occurrences of the members of this Class
+     * and the facets of their simple types, raising ValueError at the first violation.
+     * Simple types also get the check_value() class method that validate() calls for their values.
+     */
+    std::string generateValidator() const;
+
+    /**
+     * Returns a code fragment for the methods of an enumerated simple type, which keep a single
+     * constant per value so that members refer to shared instances that can be compared with 'is'.
+     */
+    std::string generateEnumerationMethods() const;
+
+    /**
+     * Writes the module level statements that create the constants of an enumerated simple type
+     * and the values dict looking them up by lexical value or content.
+     */
+    void writeEnumerationConstants(std::ostream& os) const;
+
     /**
      * Should return the name with which to refer to this Class.
      */
     virtual std::string getClassname() const;
 
+    /**
+     * Returns true if any of the elements of this Class (not counting its base) are of a complex type.
+     */
+    bool hasComplexElements() const;
+
     std::set<std::string> getIncludedClasses() const;
     std::set<std::string> getPrototypeClasses() const;
 
@@ -176,6 +274,30 @@ public:
     std::list<Member> getElements(bool includeBase, bool vectors, bool optionals) const;
 
     void writeImplementation(std::ostream& os) const;
+
+    /**
+     * Writes a random, schema-valid instance of this Class as an element called elementName.
+     * An xmlns attribute is written if nameSpace is not empty.
+     */
+    void writeSample(std::ostream& os, std::string elementName, std::string nameSpace, const SampleOptions& options, int depth) const;
+
+    /**
+     * Should return a random value of this simple Class, as it is written in documents.
+     */
+    virtual std::string generateSampleValue(const SampleOptions& options) const;
+
+    /**
+     * Returns true if this simple Class has facets that generateSampleValue() doesn't satisfy:
+     * ranges of dates and times, patterns of non-string types, or patterns in more than one step of its base chain.
+     * Samples a pattern to find out, so call it before seeding the documents.
+     */
+    bool hasUnsampledFacets() const;
+
+    /**
+     * Writes the james::native::Member table and ClassInfo entry of this Class for the --native extension module.
+     * The ClassInfo entry is written to infos so that all of them can be collected into one array.
+     */
+    void writeNativeTable(std::ostream& os, std::ostream& infos) const;
 };
 
 #endif /* _CLASS_H */
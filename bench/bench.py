@@ -0,0 +1,248 @@
+# This file is in the public domain.
+"""
+Benchmarks the Python code generated by pyjames.
+
+For every schema in SCHEMAS and every backend that can be generated (and, for --native, built) here,
+synthetic documents of each size are parsed and serialized, and the results are written as JSON
+so that runs on different commits can be compared.
+
+ python bench.py --pyjames path/to/pyjames [--sizes 100,1000,10000] [--repeat 3] [--output benchmark.json]
+
+Each size is measured in a fresh interpreter, so that the peak memory figures don't carry over between runs.
+Peak memory is taken from tracemalloc where available (Python 3.4+), which only sees memory allocated
+through Python, and the maximum resident set size of the process is reported as well.
+"""
+import sys
+import os
+import json
+import time
+import shutil
+import subprocess
+import tempfile
+import platform
+import optparse
+import timeit
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+
+def load(name):
+    """Returns the generated class name, each of which lives in a module of the same name"""
+    return getattr(__import__(name), name)
+
+def buildPersonList(count):
+    """Returns a PersonListDocument with count persons, and the number of objects in it"""
+    doc = load("PersonListDocument")()
+    PersonType = load("PersonType")
+    for i in range(count):
+        doc.person.append(PersonType("Person %d" % i, "Street %d" % i, 1900 + i % 100))
+    return doc, count + 1
+
+#benchmark schemas: the schema, the generated class of the document, and a function building a document of a given size
+SCHEMAS = {
+    "example": (os.path.join(root, "example", "example.xsd"), "PersonListDocument", buildPersonList),
+}
+
+#backends and the pyjames switches generating them
+BACKENDS = [
+    ("default", []),
+    ("expat", ["--expat"]),
+    ("native", ["--native"]),
+]
+
+class NullStream:
+    def __init__(self):
+        self.size = 0
+
+    def write(self, data):
+        self.size += len(data)
+
+def best(function, repeat):
+    times = []
+    for i in range(repeat):
+        start = timeit.default_timer()
+        function()
+        times.append(timeit.default_timer() - start)
+    return min(times)
+
+def rates(seconds, size, objects):
+    return {
+        "seconds": seconds,
+        "mb_per_s": size / seconds / 1e6 if seconds > 0 else None,
+        "objects_per_s": objects / seconds if seconds > 0 else None,
+    }
+
+def peakMemory(function):
+    try:
+        import tracemalloc
+    except ImportError:
+        return None
+
+    tracemalloc.start()
+    try:
+        function()
+        return tracemalloc.get_traced_memory()[1]
+    finally:
+        tracemalloc.stop()
+
+def maxRSS():
+    try:
+        import resource
+    except ImportError:
+        return None
+
+    #kilobytes on Linux, bytes on OS X
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return rss if sys.platform == "darwin" else rss * 1024
+
+def measure(schema, backend, directory, count, repeat):
+    """Measures a single schema, backend and size. Runs in a child process"""
+    sys.path.insert(0, directory)
+    xsd, document, build = SCHEMAS[schema]
+
+    import JamesXMLObject
+    if backend == "native" and JamesXMLObject.native == None:
+        return None
+
+    cls = load(document)
+    doc, objects = build(count)
+
+    filename = os.path.join(directory, "%s-%d.xml" % (schema, count))
+    data = doc.toxml()
+    f = open(filename, "wb")
+    try:
+        f.write(data)
+    finally:
+        f.close()
+
+    size = len(data)
+    parsed = cls.fromxml(filename)
+    if parsed.toxml() != data:
+        raise RuntimeError("%s backend doesn't reproduce the %s document" % (backend, schema))
+
+    toxml = backend == "native" and parsed.toxml_native or parsed.toxml
+
+    result = {
+        "schema": schema,
+        "backend": backend,
+        "size": count,
+        "bytes": size,
+        "objects": objects,
+        "parse": rates(best(lambda: cls.fromxml(filename), repeat), size, objects),
+        "serialize": rates(best(toxml, repeat), size, objects),
+        "write_stream": rates(best(lambda: parsed.write_stream(NullStream()), repeat), size, objects),
+    }
+
+    parsed = None
+    result["parse"]["peak_memory"] = peakMemory(lambda: cls.fromxml(filename))
+    result["max_rss"] = maxRSS()
+
+    os.remove(filename)
+    return result
+
+def generate(pyjames, flags, schema, directory, cmakeArgs):
+    """Generates (and builds) a backend into directory. Returns an error message if it can't be done"""
+    os.makedirs(directory)
+    devnull = open(os.devnull, "w")
+
+    try:
+        if subprocess.call([pyjames] + flags + [directory, schema], stdout = devnull) != 0:
+            return "pyjames failed"
+
+        shutil.copy(os.path.join(root, "py", "JamesXMLObject.py"), directory)
+
+        if "--native" in flags:
+            shutil.copy(os.path.join(root, "py", "JamesNative.h"), directory)
+
+            if subprocess.call(["cmake", "."] + cmakeArgs, cwd = directory, stdout = devnull, stderr = devnull) != 0 or \
+               subprocess.call(["cmake", "--build", "."], cwd = directory, stdout = devnull, stderr = devnull) != 0:
+                return "building _james_native failed"
+    except OSError:
+        return str(sys.exc_info()[1])
+    finally:
+        devnull.close()
+
+    return None
+
+def gitCommit():
+    try:
+        process = subprocess.Popen(["git", "rev-parse", "HEAD"], cwd = root, stdout = subprocess.PIPE, stderr = subprocess.PIPE)
+        out = process.communicate()[0]
+        return out.decode().strip() if process.returncode == 0 else None
+    except OSError:
+        return None
+
+def main():
+    parser = optparse.OptionParser(usage = "%prog --pyjames PATH [options]")
+    parser.add_option("--pyjames", help = "pyjames executable")
+    parser.add_option("--sizes", default = "100,1000,10000", help = "comma separated document sizes [%default]")
+    parser.add_option("--repeat", type = "int", default = 3, help = "take the best of this many runs [%default]")
+    parser.add_option("--schemas", default = ",".join(sorted(SCHEMAS)), help = "comma separated schemas [%default]")
+    parser.add_option("--backends", default = ",".join(b[0] for b in BACKENDS), help = "comma separated backends [%default]")
+    parser.add_option("--cmake-args", default = "", help = "extra arguments when configuring _james_native")
+    parser.add_option("--output", default = "benchmark.json", help = "results file [%default]")
+    parser.add_option("--measure", nargs = 4, help = optparse.SUPPRESS_HELP)
+    options, args = parser.parse_args()
+
+    if options.measure:
+        schema, backend, directory, count = options.measure
+        json.dump(measure(schema, backend, directory, int(count), options.repeat), sys.stdout)
+        return 0
+
+    if not options.pyjames:
+        parser.error("--pyjames is required")
+
+    sizes = [int(s) for s in options.sizes.split(",")]
+    backends = options.backends.split(",")
+    work = tempfile.mkdtemp(prefix = "pyjames-bench-")
+    results = []
+
+    try:
+        for schema in options.schemas.split(","):
+            for backend, flags in BACKENDS:
+                if backend not in backends:
+                    continue
+
+                directory = os.path.join(work, schema + "-" + backend)
+                error = generate(os.path.abspath(options.pyjames), flags, SCHEMAS[schema][0], directory, options.cmake_args.split())
+
+                if error:
+                    sys.stderr.write("skipping %s/%s: %s\n" % (schema, backend, error))
+                    continue
+
+                for count in sizes:
+                    process = subprocess.Popen([sys.executable, os.path.abspath(__file__), "--repeat", str(options.repeat),
+                                                "--measure", schema, backend, directory, str(count)], stdout = subprocess.PIPE)
+                    out = process.communicate()[0]
+
+                    if process.returncode != 0:
+                        return 1
+
+                    result = json.loads(out.decode())
+
+                    if result == None:
+                        sys.stderr.write("skipping %s/%s: _james_native can't be imported\n" % (schema, backend))
+                        break
+
+                    results.append(result)
+                    sys.stdout.write("%-10s %-8s %8d  parse %8.1f objects/s  serialize %8.1f objects/s\n" % (schema, backend, count,
+                                     result["parse"]["objects_per_s"] or 0, result["serialize"]["objects_per_s"] or 0))
+    finally:
+        shutil.rmtree(work, True)
+
+    f = open(options.output, "w")
+    try:
+        json.dump({
+            "commit": gitCommit(),
+            "date": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime()),
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "results": results,
+        }, f, indent = 2, sort_keys = True)
+    finally:
+        f.close()
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
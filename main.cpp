@@ -25,6 +25,11 @@
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
+#include <cstdlib>
+#include <climits>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
 #include <xercesc/parsers/XercesDOMParser.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
@@ -46,14 +51,50 @@ using namespace xercesc;
 using namespace james;
 
 static void printUsage() {
-    cerr << "USAGE: pyjames [-v] [--dry-run] output-dir list-of-XSL-documents" << endl;
+    cerr << "USAGE: pyjames [-v] [--dry-run] [--expat] [--native] [--lazy] [--typed-arrays] [--validate] [--dirty] [--instrument] [--inline-depth depth] [--intern names] [--intern-file file] [--sample element count [sample options]] output-dir list-of-XSL-documents" << endl;
     cerr << " -v\tVerbose mode" << endl;
     cerr << " --dry-run\tPerform generation but don't write anything to disk - instead does exit(1) if any file changes" << endl;
+    cerr << " --expat\tMake fromxml() bind documents straight from pyexpat events instead of going through minidom" << endl;
+    cerr << " --native\tAlso generate _james_native.cpp, a CPython extension module built on libjames, and a CMakeLists.txt for building it" << endl;
+    cerr << " --lazy\tMake parse_node() bind complex child elements when they are first read rather than up front" << endl;
+    cerr << " --typed-arrays\tStore arrays of built-in numeric types in array.array instead of lists" << endl;
+    cerr << " --validate\tMake fromxml() check the facets and occurrences of the schema with validate() after binding" << endl;
+    cerr << " --dirty\tMake write_xml() and toxml() reuse the XML text of objects that haven't changed since they were last written" << endl;
+    cerr << " --instrument\tMake the generated classes count their objects, elements, time and bytes, see snapshotCounters()" << endl;
+    cerr << " --inline-depth depth\tGive document classes a single parse_node() that also binds complex child elements down to this depth" << endl;
+    cerr << " --intern names\tIntern the string values of the given types and Type.member members, separated by commas" << endl;
+    cerr << " --intern-file file\tSame as --intern with the names listed in a file, one or more per line, # starting comments" << endl;
+    cerr << " --sample element count\tInstead of generating code, write count random instance documents of the given document element to output-dir" << endl;
+    cerr << " --sample-seed seed\tSeed of the random instance documents (default 1)" << endl;
+    cerr << " --sample-occurs min max\tNumber of items written for each array, within the bounds of the schema (default 0 5)" << endl;
+    cerr << " --sample-string-length min max\tLength of strings, and of hexBinary values in bytes (default 1 16)" << endl;
+    cerr << " --sample-depth depth\tOnly write required members below this depth, which limits recursive types (default 8)" << endl;
     cerr << endl;
     cerr << " Generates Python classes for marshalling and unmarshalling XML to Python objects according to the given schemas." << endl;
     cerr << " Files are output in the specified output directory and are named type.py" << endl;
 }
 
+/**
+ * Parses the integer argument arg of option, which has to be between min and max.
+ * Throws invalid_argument otherwise, upon which main() prints the usage.
+ */
+static int parseIntArgument(const char *option, const char *arg, int min, int max = INT_MAX) {
+    char *end;
+    long value = strtol(arg, &end, 10);
+
+    if(!*arg || *end || value < min || value > max) {
+        ostringstream oss;
+        oss << "Bad argument " << arg << " to " << option << ", expected an integer from " << min;
+
+        if(max != INT_MAX)
+            oss << " to " << max;
+
+        throw invalid_argument(oss.str());
+    }
+
+    return value;
+}
+
 //maps namespace abbreviation to their full URIs
 map<string, string> nsLUT;
 
@@ -65,6 +106,39 @@ map<FullName, shared_ptr<Class> > groups;
 
 bool verbose = false;
 
+//if true, the generated fromxml() methods use ExpatBinder rather than minidom
+bool useExpat = false;
+
+//if true, the _james_native extension module is generated and used by fromxml() when importable
+bool useNative = false;
+
+//if true, parse_node() leaves complex child elements unbound until they are first read
+bool useLazy = false;
+
+//if true, arrays of built-in numeric types are stored in array.array rather than lists
+bool useTypedArrays = false;
+
+//if true, the generated factory methods call validate() on the objects they bind
+bool useValidation = false;
+
+//if true, objects track assignments and keep the XML text written for them until they or their children change
+bool useDirty = false;
+
+//if true, every generated module ends with a call to instrument(), which wraps the methods of its class with counters
+bool useInstrument = false;
+
+//how deep the parse_node() of document classes binds complex child elements itself instead of calling their fromNode()
+int inlineDepth = 0;
+
+//types and Type.member members whose string values are interned (--intern and --intern-file)
+static vector<string> internNames;
+
+//document element to write sample instance documents of, and how many (--sample)
+static string sampleElement;
+static int sampleCount = 0;
+static unsigned sampleSeed = 1;
+static SampleOptions sampleOptions;
+
 static shared_ptr<Class> addClass(shared_ptr<Class> cl, map<FullName, shared_ptr<Class> >& to = classes) {
     if(to.find(cl->name) != to.end())
         throw runtime_error(cl->name.first + ":" + cl->name.second + " defined more than once");
@@ -378,6 +452,310 @@ static void parseComplexType(DOMElement *element, FullName fullName, shared_ptr<
     }
 }
 
+/**
+ * Appends the code point c to out as UTF-8.
+ */
+static void appendUTF8(string& out, unsigned c) {
+    if(c < 0x80) {
+        out += (char)c;
+    } else if(c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    } else if(c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    } else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+/**
+ * Decodes the UTF-8 string str into code points.
+ */
+static vector<unsigned> decodeUTF8(const string& str) {
+    vector<unsigned> ret;
+
+    for(size_t x = 0; x < str.size();) {
+        unsigned char c = str[x++];
+        int more = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+
+        if(more < 0 || x + more > str.size())
+            throw runtime_error("not valid UTF-8");
+
+        unsigned value = more == 0 ? c : c & (0x3F >> more);
+
+        for(; more > 0; more--) {
+            if((str[x] & 0xC0) != 0x80)
+                throw runtime_error("not valid UTF-8");
+
+            value = (value << 6) | (str[x++] & 0x3F);
+        }
+
+        ret.push_back(value);
+    }
+
+    return ret;
+}
+
+//name characters of XML 1.0 fifth edition within the Basic Multilingual Plane, which \i and \c of patterns match
+static const unsigned nameStartRanges[][2] = {{':', ':'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}, {0xC0, 0xD6}, {0xD8, 0xF6},
+    {0xF8, 0x2FF}, {0x370, 0x37D}, {0x37F, 0x1FFF}, {0x200C, 0x200D}, {0x2070, 0x218F}, {0x2C00, 0x2FEF}, {0x3001, 0xD7FF},
+    {0xF900, 0xFDCF}, {0xFDF0, 0xFFFD}};
+static const unsigned nameRanges[][2] = {{'-', '.'}, {'0', '9'}, {0xB7, 0xB7}, {0x300, 0x36F}, {0x203F, 0x2040}};
+
+/**
+ * Appends the character c to the Python regular expression out, matching only itself inside and outside character classes.
+ */
+static void appendPatternChar(string& out, unsigned c) {
+    const char *digits = "0123456789abcdef";
+
+    if(c >= 0x80 || isalnum(c)) {
+        appendUTF8(out, c);
+    } else if(c == '\n') {
+        out += "\\n";
+    } else if(c == '\r') {
+        out += "\\r";
+    } else if(c == '\t') {
+        out += "\\t";
+    } else if(c < 32 || c == 127) {
+        out += "\\x";
+        out += digits[c >> 4];
+        out += digits[c & 15];
+    } else {
+        //escaping all punctuation also keeps Python 3.7+ from warning about [[, --, && and the like in classes
+        out += '\\';
+        out += (char)c;
+    }
+}
+
+/**
+ * Returns the contents of a character class matching the name characters of \i, or of \c if all is set.
+ */
+static string getNameClass(bool all) {
+    string ret;
+
+    for(size_t x = 0; x < sizeof(nameStartRanges) / sizeof(nameStartRanges[0]) + (all ? sizeof(nameRanges) / sizeof(nameRanges[0]) : 0); x++) {
+        const unsigned *range = x < sizeof(nameStartRanges) / sizeof(nameStartRanges[0]) ? nameStartRanges[x] : nameRanges[x - sizeof(nameStartRanges) / sizeof(nameStartRanges[0])];
+
+        appendPatternChar(ret, range[0]);
+
+        if(range[1] != range[0]) {
+            ret += '-';
+            appendPatternChar(ret, range[1]);
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Reads the character of a single character escape of an XML Schema regular expression, the backslash already read.
+ * Returns false, leaving pos alone, if the escape stands for several characters.
+ */
+static bool readSingleCharEscape(const vector<unsigned>& pattern, size_t& pos, unsigned& c) {
+    if(pos >= pattern.size())
+        throw runtime_error("ends with a backslash");
+
+    c = pattern[pos];
+
+    if(c == 'n' || c == 'r' || c == 't')
+        c = c == 'n' ? '\n' : c == 'r' ? '\r' : '\t';
+    else if(!strchr("\\|.-^?*+{}()[]", c))
+        return false;
+
+    pos++;
+    return true;
+}
+
+/**
+ * Translates the multiple character escape at pos of an XML Schema regular expression, the backslash already read.
+ * Inside a character class the contents of a class are returned rather than an atom.
+ * \p, \P, \w and \W have no equivalent in the re module and throw.
+ */
+static string translateClassEscape(const vector<unsigned>& pattern, size_t& pos, bool inClass) {
+    unsigned c = pattern[pos++];
+
+    switch(c) {
+    case 'd':
+    case 'D':
+        //the same as \p{Nd} with re.UNICODE
+        return c == 'd' ? "\\d" : "\\D";
+    case 's':
+        return inClass ? " \\t\\n\\r" : "[ \\t\\n\\r]";
+    case 'i':
+    case 'c':
+        return inClass ? getNameClass(c == 'c') : "[" + getNameClass(c == 'c') + "]";
+    case 'S':
+    case 'I':
+    case 'C':
+        if(!inClass)
+            return c == 'S' ? "[^ \\t\\n\\r]" : "[^" + getNameClass(c == 'C') + "]";
+        break;
+    case 'p':
+    case 'P':
+        throw runtime_error("Unicode categories and blocks (\\p, \\P) are not supported");
+    case 'w':
+    case 'W':
+        throw runtime_error("\\w and \\W are not supported");
+    default:
+        throw runtime_error(string("unknown escape \\") + (char)c);
+    }
+
+    throw runtime_error(string("\\") + (char)c + " is not supported inside character classes");
+}
+
+/**
+ * Translates the character class expression at pos of an XML Schema regular expression, the [ already read,
+ * into an atom of a Python regular expression. Subtractions like [a-z-[aeiou]] become negative lookaheads.
+ */
+static string translateCharClass(const vector<unsigned>& pattern, size_t& pos) {
+    string body;
+    bool negated = pos < pattern.size() && pattern[pos] == '^';
+
+    if(negated)
+        pos++;
+
+    for(;;) {
+        if(pos >= pattern.size())
+            throw runtime_error("unterminated character class");
+
+        unsigned c = pattern[pos++];
+        unsigned to;
+
+        if(c == ']' && !body.empty())
+            return string("[") + (negated ? "^" : "") + body + "]";
+
+        if(c == '-' && pos < pattern.size() && pattern[pos] == '[' && !body.empty()) {
+            pos++;
+            string subtracted = translateCharClass(pattern, pos);
+
+            if(pos >= pattern.size() || pattern[pos] != ']')
+                throw runtime_error("a class subtraction must end the character class");
+
+            pos++;
+            return "(?:(?!" + subtracted + ")[" + (negated ? "^" : "") + body + "])";
+        }
+
+        if(c == '[' || c == ']')
+            throw runtime_error("unescaped [ or ] in a character class");
+
+        if(c == '\\' && !readSingleCharEscape(pattern, pos, c)) {
+            body += translateClassEscape(pattern, pos, true);
+
+            if(pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']' && pattern[pos + 1] != '[')
+                throw runtime_error("a multiple character escape can't start a range");
+
+            continue;
+        }
+
+        appendPatternChar(body, c);
+
+        //a range, unless - is the last character of the class or starts a subtraction
+        if(pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']' && pattern[pos + 1] != '[') {
+            pos++;
+            to = pattern[pos++];
+
+            if(to == '[' || (to == '\\' && !readSingleCharEscape(pattern, pos, to)))
+                throw runtime_error("bad end of a character range");
+
+            if(to < c)
+                throw runtime_error("character range out of order");
+
+            body += '-';
+            appendPatternChar(body, to);
+        }
+    }
+}
+
+/**
+ * Translates pattern, an XML Schema regular expression in UTF-8, into a Python regular expression in UTF-8
+ * that matches the same strings when compiled with re.UNICODE and anchored at both ends.
+ * Throws runtime_error if pattern is malformed or uses syntax the re module can't express.
+ */
+static string translatePattern(const string& utf8) {
+    vector<unsigned> pattern = decodeUTF8(utf8);
+    string ret;
+    int depth = 0;
+    bool quantifiable = false;  //whether an atom precedes, which a quantifier may follow
+
+    for(size_t pos = 0; pos < pattern.size();) {
+        unsigned c = pattern[pos++];
+
+        if(c == '?' || c == '*' || c == '+' || c == '{') {
+            if(!quantifiable)
+                throw runtime_error("quantifier without anything to repeat");
+
+            ret += (char)c;
+
+            if(c == '{') {
+                //{n}, {n,} or {n,m}
+                string min, max;
+                bool comma = false;
+
+                for(; pos < pattern.size() && pattern[pos] != '}'; pos++) {
+                    if(pattern[pos] == ',' && !comma)
+                        comma = true;
+                    else if(pattern[pos] >= '0' && pattern[pos] <= '9')
+                        (comma ? max : min) += (char)pattern[pos];
+                    else
+                        throw runtime_error("malformed quantifier");
+                }
+
+                //the re module of Python 2 can't repeat more than 65535 times
+                if(pos >= pattern.size() || min.empty() || min.size() > 5 || max.size() > 5 || atoi(min.c_str()) > 65535 ||
+                        atoi(max.c_str()) > 65535 || (!max.empty() && atoi(max.c_str()) < atoi(min.c_str())))
+                    throw runtime_error("malformed or too large quantifier");
+
+                ret += min + (comma ? "," : "") + max + "}";
+                pos++;
+            }
+
+            quantifiable = false;
+            continue;
+        }
+
+        quantifiable = true;
+
+        if(c == '\\') {
+            if(readSingleCharEscape(pattern, pos, c))
+                appendPatternChar(ret, c);
+            else
+                ret += translateClassEscape(pattern, pos, false);
+        } else if(c == '[') {
+            ret += translateCharClass(pattern, pos);
+        } else if(c == '.') {
+            //. matches carriage returns in Python
+            ret += "[^\\n\\r]";
+        } else if(c == '(') {
+            ret += "(?:";
+            depth++;
+            quantifiable = false;
+        } else if(c == ')') {
+            if(--depth < 0)
+                throw runtime_error("unbalanced parenthesis");
+
+            ret += ')';
+        } else if(c == '|') {
+            ret += '|';
+            quantifiable = false;
+        } else if(c == ']' || c == '}') {
+            throw runtime_error("unescaped ] or }");
+        } else {
+            //includes ^ and $, which are ordinary characters in XML Schema
+            appendPatternChar(ret, c);
+        }
+    }
+
+    if(depth != 0)
+        throw runtime_error("unbalanced parenthesis");
+
+    return ret;
+}
+
 static void parseSimpleType(DOMElement *element, FullName fullName) {
     //expect a <restriction> child element
     CHECK(element);
@@ -390,8 +768,82 @@ static void parseSimpleType(DOMElement *element, FullName fullName) {
     //convert xs:string and the like to their respective FullName
     FullName baseName = toFullName(XercesString(restriction->getAttribute(XercesString("base"))));
 
+    shared_ptr<Class> cl(new Class(fullName, Class::SIMPLE_TYPE, baseName));
+
+    //facets checked by validate()
+    const char *facets[] = {"minInclusive", "maxInclusive", "minExclusive", "maxExclusive", "length", "minLength", "maxLength", "pattern", "totalDigits"};
+
+    bool unsupportedPattern = false;
+
+    for(size_t x = 0; x < sizeof(facets) / sizeof(const char*); x++) {
+        vector<DOMElement*> children = getChildElementsByTagName(restriction, facets[x]);
+
+        for(size_t y = 0; y < children.size(); y++) {
+            if(!children[y]->hasAttribute(XercesString("value")))
+                throw runtime_error(string("<") + facets[x] + "> missing expected attribute 'value'");
+
+            string value = XercesString(children[y]->getAttribute(XercesString("value")));
+
+            if(!strcmp(facets[x], "pattern")) {
+                //an unsupported pattern among several in the same restriction leaves all of them unchecked
+                if(unsupportedPattern)
+                    continue;
+
+                try {
+                    value = translatePattern(value);
+                } catch(const runtime_error& e) {
+                    cerr << "Pattern " << value << " of " << fullName.second << ": " << e.what() << " - not checking the patterns of "
+                         << fullName.second << endl;
+                    cl->facets.erase(facets[x]);
+                    unsupportedPattern = true;
+                    continue;
+                }
+
+                //patterns are implicitly anchored, and several of them in the same restriction are alternatives
+                value = "(?:" + value + ")";
+
+                if(cl->facets.find(facets[x]) != cl->facets.end())
+                    value = cl->facets[facets[x]] + "|" + value;
+            } else if(!strstr(facets[x], "clusive")) {
+                //lengths and totalDigits
+                if(value.empty() || value.find_first_not_of("0123456789") != string::npos)
+                    throw runtime_error(string("<") + facets[x] + "> of " + fullName.second + " must be a non-negative integer");
+            }
+
+            cl->facets[facets[x]] = value;
+        }
+    }
+
+    //enumeration facets become constants of the generated class
+    //their identifiers are uppercased so that they can't clash with any method or member
+    vector<DOMElement*> enumerations = getChildElementsByTagName(restriction, "enumeration");
+    set<string> identifiers;
+
+    for(size_t x = 0; x < enumerations.size(); x++) {
+        if(!enumerations[x]->hasAttribute(XercesString("value")))
+            throw runtime_error("<enumeration> missing expected attribute 'value'");
+
+        string value = XercesString(enumerations[x]->getAttribute(XercesString("value")));
+        string identifier = value;
+
+        for(size_t y = 0; y < identifier.size(); y++)
+            identifier[y] = toupper((unsigned char)identifier[y]);
+
+        identifier = fixIdentifier(identifier);
+
+        if(identifier.empty() || (identifier[0] >= '0' && identifier[0] <= '9'))
+            identifier = "_" + identifier;
+
+        //values only differing in case or punctuation
+        while(identifiers.find(identifier) != identifiers.end())
+            identifier += "_";
+
+        identifiers.insert(identifier);
+        cl->enumerations.push_back(make_pair(value, identifier));
+    }
+
     //add class and return
-    addClass(shared_ptr<Class>(new Class(fullName, Class::SIMPLE_TYPE, baseName)));
+    addClass(cl);
 }
 
 static void parseElement(DOMElement *element, string tns) {
@@ -590,6 +1042,221 @@ static void diffAndReplace(string fileName, string newContents, bool dry_run) {
     }
 }
 
+/**
+ * Returns the source of the _james_native extension module, which consists of the tables of every class.
+ * The code that makes use of the tables lives in py/JamesNative.h.
+ */
+static string generateNativeModule() {
+    ostringstream tables, infos;
+
+    for(map<FullName, shared_ptr<Class> >::iterator it = classes.begin(); it != classes.end(); it++)
+        if(!it->second->isBuiltIn())
+            it->second->writeNativeTable(tables, infos);
+
+    ostringstream oss;
+
+    oss << "/* Generated by pyjames. Do not edit. */" << endl;
+    oss << "#include \"JamesNative.h\"" << endl << endl;
+    oss << "using namespace james::native;" << endl << endl;
+    oss << tables.str();
+    oss << "static const ClassInfo classInfos[] = {" << endl;
+    oss << infos.str();
+    oss << "    {NULL, NONE, NULL}," << endl;
+    oss << "};" << endl << endl;
+    oss << "JAMES_NATIVE_MODULE(_james_native, classInfos)" << endl;
+
+    return oss.str();
+}
+
+/**
+ * Returns the source of the JamesDocuments module, which maps the namespace and name of the root element
+ * of every document class to the class, for parse_any().
+ */
+static string generateDocumentRegistry() {
+    ostringstream imports, entries;
+
+    for(map<FullName, shared_ptr<Class> >::iterator it = classes.begin(); it != classes.end(); it++) {
+        if(it->second->isBuiltIn() || !it->second->isDocument)
+            continue;
+
+        string className = it->second->getClassname();
+
+        imports << "from " << className << " import *" << endl;
+        entries << "    (\"" << it->first.first << "\", \"" << it->first.second << "\"): " << className << "," << endl;
+    }
+
+    ostringstream oss;
+
+    oss << "# Generated by pyjames. Do not edit." << endl;
+    oss << "from JamesXMLObject import *" << endl;
+    oss << imports.str() << endl;
+    oss << "#document classes by the namespace and local name of their root element" << endl;
+    oss << "documents = {" << endl;
+    oss << entries.str();
+    oss << "}" << endl << endl;
+
+    //parse_any() and parse_any_bytes(), the counterparts of fromxml() and from_bytes()
+    string validate = useValidation ? "    obj.validate()\n" : "";
+
+    oss << "def parse_any(source):" << endl;
+    oss << "    \"\"\"" << endl;
+    oss << "    Binds the document in the file name or file object source with the class of its root element in documents." << endl;
+    oss << "    The document is read once, by the expat backend. Raises ValueError if no class was generated for the root element." << endl;
+    oss << "    \"\"\"" << endl;
+    oss << "    obj = DocumentBinder(documents).parse(source)" << endl;
+    oss << validate;
+    oss << "    return obj" << endl << endl;
+
+    oss << "def parse_any_bytes(data):" << endl;
+    oss << "    \"\"\"Same as parse_any() for a document held in memory, see from_bytes()\"\"\"" << endl;
+    oss << "    obj = DocumentBinder(documents).parse_buffer(data)" << endl;
+    oss << validate;
+    oss << "    return obj" << endl;
+
+    return oss.str();
+}
+
+/**
+ * Returns a CMakeLists.txt for building the _james_native extension module against an installed libjames.
+ */
+static string generateNativeCMakeLists() {
+    ostringstream oss;
+
+    oss << "# Generated by pyjames. Do not edit." << endl;
+    oss << "cmake_minimum_required(VERSION 2.6)" << endl;
+    oss << "project(_james_native)" << endl << endl;
+    oss << "find_package(PythonLibs REQUIRED)" << endl;
+    oss << "find_path(JAMES_INCLUDE_DIR libjames/XercesString.h)" << endl;
+    oss << "find_library(JAMES_LIBRARY james)" << endl << endl;
+    oss << "include_directories(${CMAKE_CURRENT_SOURCE_DIR} ${PYTHON_INCLUDE_PATH} ${JAMES_INCLUDE_DIR})" << endl << endl;
+    oss << "add_library(_james_native MODULE _james_native.cpp)" << endl;
+    oss << "set_target_properties(_james_native PROPERTIES PREFIX \"\")" << endl << endl;
+    oss << "if(WIN32)" << endl;
+    oss << "    set_target_properties(_james_native PROPERTIES SUFFIX \".pyd\")" << endl;
+    oss << "    target_link_libraries(_james_native ${JAMES_LIBRARY} xerces-c_3 ${PYTHON_LIBRARIES})" << endl;
+    oss << "else(WIN32)" << endl;
+    oss << "    target_link_libraries(_james_native ${JAMES_LIBRARY} xerces-c ${PYTHON_LIBRARIES})" << endl;
+    oss << "endif(WIN32)" << endl;
+
+    return oss.str();
+}
+
+/**
+ * Adds the names in text, separated by commas or whitespace, to internNames. # starts a comment running to the end of the line.
+ */
+static void addInternNames(const string& text) {
+    istringstream lines(text);
+    string line;
+
+    while(getline(lines, line)) {
+        line = line.substr(0, line.find('#'));
+        replace(line.begin(), line.end(), ',', ' ');
+
+        istringstream iss(line);
+        string name;
+
+        while(iss >> name)
+            internNames.push_back(name);
+    }
+}
+
+/**
+ * Marks the types and members named by internNames as interned.
+ * Members are named by the type declaring them and their name, as in PersonType.address.
+ */
+static void applyInternNames() {
+    for(size_t x = 0; x < internNames.size(); x++) {
+        string name = internNames[x], memberName;
+        size_t dot = name.find('.');
+        bool found = false;
+
+        if(dot != string::npos) {
+            memberName = name.substr(dot + 1);
+            name = name.substr(0, dot);
+        }
+
+        for(map<FullName, shared_ptr<Class> >::iterator it = classes.begin(); it != classes.end(); it++) {
+            if(it->first.second != name)
+                continue;
+
+            if(memberName.empty()) {
+                it->second->interned = found = true;
+            } else {
+                list<Class::Member>::iterator member = it->second->findMember(memberName);
+
+                if(member != it->second->members.end())
+                    member->interned = found = true;
+            }
+        }
+
+        if(!found)
+            throw runtime_error("No type or member called " + internNames[x] + " to intern");
+
+        if(verbose) cerr << "Interning " << internNames[x] << endl;
+    }
+}
+
+/**
+ * Gathers the names of the simple classes reachable from cl whose facets Class::generateSampleValue() doesn't satisfy.
+ */
+static void findUnsampledClasses(const Class *cl, set<const Class*>& visited, set<string>& unsampled) {
+    if(!cl || cl->isBuiltIn() || !visited.insert(cl).second)
+        return;
+
+    if(cl->isSimple()) {
+        if(cl->hasUnsampledFacets())
+            unsampled.insert(cl->name.second);
+
+        return;
+    }
+
+    findUnsampledClasses(cl->base, visited, unsampled);
+
+    for(list<Class::Member>::const_iterator it = cl->members.begin(); it != cl->members.end(); it++)
+        findUnsampledClasses(it->cl, visited, unsampled);
+}
+
+/**
+ * Writes sampleCount random instance documents of the document element called sampleElement to outputDir,
+ * named element-1.xml, element-2.xml and so on.
+ * Each document is written straight to its file rather than built in memory first, so large corpora can be produced.
+ */
+static void writeSamples(string outputDir) {
+    const Class *document = NULL;
+
+    for(map<FullName, shared_ptr<Class> >::iterator it = classes.begin(); it != classes.end(); it++)
+        if(it->second->isDocument && it->first.second == sampleElement)
+            document = it->second.get();
+
+    if(!document)
+        throw runtime_error("No document element called " + sampleElement);
+
+    set<const Class*> visited;
+    set<string> unsampled;
+    findUnsampledClasses(document, visited, unsampled);
+
+    for(set<string>::iterator it = unsampled.begin(); it != unsampled.end(); it++)
+        cerr << "Warning: the patterns or date and time ranges of " << *it << " are not taken into account - sample values may not pass validate()" << endl;
+
+    srand(sampleSeed);
+
+    for(int x = 1; x <= sampleCount; x++) {
+        ostringstream name;
+        name << outputDir << "/" << sampleElement << "-" << x << ".xml";
+
+        ofstream ofs(name.str().c_str());
+
+        if(!ofs)
+            throw runtime_error("Failed to open " + name.str() + " for writing");
+
+        if(verbose) cerr << "A " << name.str() << endl;
+
+        ofs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl;
+        document->writeSample(ofs, sampleElement, document->name.first, sampleOptions, 0);
+        ofs << endl;
+    }
+}
+
 int main(int argc, char** argv) {
     try {
         bool dry_run = false;
@@ -609,12 +1276,112 @@ int main(int argc, char** argv) {
                 dry_run = true;
                 if(verbose) cerr << "Peforming dry run" << endl;
 
+                continue;
+            } else if(!strcmp(argv[1], "--expat")) {
+                useExpat = true;
+                if(verbose) cerr << "Using the expat backend" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--native")) {
+                useNative = true;
+                if(verbose) cerr << "Generating native extension module" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--lazy")) {
+                useLazy = true;
+                if(verbose) cerr << "Binding complex elements lazily" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--typed-arrays")) {
+                useTypedArrays = true;
+                if(verbose) cerr << "Storing numeric arrays in array.array" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--validate")) {
+                useValidation = true;
+                if(verbose) cerr << "Validating bound documents" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--dirty")) {
+                useDirty = true;
+                if(verbose) cerr << "Caching the XML text of unchanged objects" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--instrument")) {
+                useInstrument = true;
+                if(verbose) cerr << "Instrumenting the generated classes" << endl;
+
+                continue;
+            } else if(!strcmp(argv[1], "--inline-depth") && argc > 4) {
+                inlineDepth = parseIntArgument(argv[1], argv[2], 0);
+                if(verbose) cerr << "Inlining parsers down to depth " << inlineDepth << endl;
+
+                argv++;
+                argc--;
+                continue;
+            } else if(!strcmp(argv[1], "--intern") && argc > 4) {
+                addInternNames(argv[2]);
+
+                argv++;
+                argc--;
+                continue;
+            } else if(!strcmp(argv[1], "--intern-file") && argc > 4) {
+                ifstream ifs(argv[2]);
+
+                if(!ifs)
+                    throw runtime_error(string("Failed to read ") + argv[2]);
+
+                addInternNames(readIstreamToString(ifs));
+
+                argv++;
+                argc--;
+                continue;
+            } else if(!strcmp(argv[1], "--sample") && argc > 5) {
+                sampleElement = argv[2];
+                sampleCount = parseIntArgument(argv[1], argv[3], 1);
+                if(verbose) cerr << "Writing " << sampleCount << " sample documents of " << sampleElement << endl;
+
+                argv += 2;
+                argc -= 2;
+                continue;
+            } else if(!strcmp(argv[1], "--sample-seed") && argc > 4) {
+                sampleSeed = parseIntArgument(argv[1], argv[2], 0);
+
+                argv++;
+                argc--;
+                continue;
+            } else if(!strcmp(argv[1], "--sample-occurs") && argc > 5) {
+                sampleOptions.minOccurs = parseIntArgument(argv[1], argv[2], 0);
+                sampleOptions.maxOccurs = parseIntArgument(argv[1], argv[3], sampleOptions.minOccurs);
+
+                argv += 2;
+                argc -= 2;
+                continue;
+            } else if(!strcmp(argv[1], "--sample-string-length") && argc > 5) {
+                sampleOptions.minStringLength = parseIntArgument(argv[1], argv[2], 0);
+                sampleOptions.maxStringLength = parseIntArgument(argv[1], argv[3], sampleOptions.minStringLength);
+
+                argv += 2;
+                argc -= 2;
+                continue;
+            } else if(!strcmp(argv[1], "--sample-depth") && argc > 4) {
+                sampleOptions.maxDepth = parseIntArgument(argv[1], argv[2], 0);
+
+                argv++;
+                argc--;
                 continue;
             }
 
             break;
         }
 
+        //an option left over is either unknown or missing some of its arguments, so don't take it for the output directory
+        if(argv[1][0] == '-') {
+            cerr << "Unknown option or too few arguments: " << argv[1] << endl;
+            printUsage();
+            return 1;
+        }
+
         XMLPlatformUtils::Initialize();
 
         initKeywordSet();
@@ -651,9 +1418,17 @@ int main(int argc, char** argv) {
             schemaNames.push_back(argv[x]);
 
         work(outputDir, schemaNames);
+        applyInternNames();
 
         doPostResolveInits();
 
+        if(!sampleElement.empty()) {
+            writeSamples(outputDir);
+
+            XMLPlatformUtils::Terminate();
+            return 0;
+        }
+
         if(verbose) cerr << "Everything seems to be in order. Writing/updating headers and implementations as needed." << endl;
 
         //dump the appenders and parsers of all non-build-in classes
@@ -671,6 +1446,13 @@ int main(int argc, char** argv) {
             }
         }
 
+        diffAndReplace(outputDir + "/JamesDocuments.py", generateDocumentRegistry(), dry_run);
+
+        if(useNative) {
+            diffAndReplace(outputDir + "/_james_native.cpp", generateNativeModule(), dry_run);
+            diffAndReplace(outputDir + "/CMakeLists.txt", generateNativeCMakeLists(), dry_run);
+        }
+
         XMLPlatformUtils::Terminate();
 
         if(dry_run) {
@@ -682,6 +1464,10 @@ int main(int argc, char** argv) {
         }
 
         return 0;
+    } catch(const invalid_argument& e) {
+        cerr << e.what() << endl;
+        printUsage();
+        return 1;
     } catch(const std::exception& e) {
         cerr << "Caught exception: " << e.what() << endl;
         return 1;
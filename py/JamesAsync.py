@@ -0,0 +1,36 @@
+# This file is in the public domain.
+"""
+asyncio helpers for the document classes generated by pyjames, which bind a document while it is being received.
+Requires Python 3.5 or later, unlike JamesXMLObject.py. Copy it next to JamesXMLObject.py to use it:
+
+ doc = await read_document(PersonListDocument, reader)
+"""
+
+async def read_document(cls, reader, chunk_size = 65536):
+    """
+    Binds a document of the generated document class cls read from reader, an asyncio.StreamReader
+    or anything else with a coroutine read(n), until the end of the stream.
+    Each chunk is parsed as soon as it has been read, so parsing overlaps with receiving the rest.
+    """
+    parser = cls.incremental_parser()
+
+    while True:
+        data = await reader.read(chunk_size)
+        if not data:
+            break
+
+        parser.feed(data)
+
+    return parser.close()
+
+async def parse_chunks(cls, chunks):
+    """
+    Binds a document of the generated document class cls from an asynchronous iterable of bytes,
+    such as the body of a streamed HTTP request.
+    """
+    parser = cls.incremental_parser()
+
+    async for data in chunks:
+        parser.feed(data)
+
+    return parser.close()
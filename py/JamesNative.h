@@ -0,0 +1,723 @@
+/* This file is in the public domain.
+ *
+ * File:   JamesNative.h
+ *
+ * Runtime for the CPython extension modules generated by pyjames --native.
+ * The generated _james_native.cpp contains one ClassInfo table per class and
+ * instantiates the module with JAMES_NATIVE_MODULE(). Documents are parsed
+ * with the Xerces-C++ SAX2 reader and bound straight into the generated
+ * Python objects, and serialized without going through minidom.
+ */
+
+#ifndef _JAMESNATIVE_H
+#define _JAMESNATIVE_H
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLUni.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/TransService.hpp>
+#include <xercesc/util/XMLException.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include "libjames/HexBinary.h"
+
+#if PY_MAJOR_VERSION >= 3
+#define JAMES_STRING_FROM(str, len) PyUnicode_FromStringAndSize(str, len)
+#define JAMES_INTERN(str) PyUnicode_InternFromString(str)
+#define JAMES_INT_FROM(str) PyLong_FromString(str, NULL, 10)
+#define JAMES_BYTES_FROM(str, len) PyBytes_FromStringAndSize(str, len)
+#define JAMES_BUFFER_FORMAT "Oy*"
+#else
+#define JAMES_STRING_FROM(str, len) stringFromUTF8(str, len)
+#define JAMES_INTERN(str) PyString_InternFromString(str)
+#define JAMES_INT_FROM(str) PyInt_FromString(str, NULL, 10)
+#define JAMES_BYTES_FROM(str, len) PyString_FromStringAndSize(str, len)
+#define JAMES_BUFFER_FORMAT "Os*"
+#endif
+
+namespace james {
+namespace native {
+    /**
+     * How the value of a member (or the text content of a class) is converted.
+     * Mirrors the converters used by the generated Python code.
+     */
+    enum Kind {
+        NONE,       //no text content
+        STRING,     //str()
+        INT,        //int()
+        LONG,       //long()
+        FLOAT,      //float()
+        BOOL,       //strToBool()
+        HEX,        //strToHex()
+        INTERNED,   //strToInterned()
+        SIMPLE,     //from_value() of a generated simple type
+        COMPLEX,    //generated complex type
+    };
+
+    struct Member {
+        const char *name;
+        bool isAttribute;
+        bool isArray;
+        Kind kind;
+        const char *className;  //class of SIMPLE and COMPLEX members, otherwise NULL
+    };
+
+    struct ClassInfo {
+        const char *name;
+        Kind content;           //kind of the text content of simple types and simpleContent, otherwise NONE
+        const Member *members;  //attributes first, sorted by name, then elements in document order. terminated by a NULL name
+    };
+
+    class BoundClass;
+
+    /**
+     * A Member along with its interned Python name and resolved class.
+     */
+    struct BoundMember {
+        const Member *member;
+        PyObject *name;
+        BoundClass *cl;
+    };
+
+    class BoundClass {
+    public:
+        const ClassInfo *info;
+        PyObject *type;     //set by register()
+        std::vector<BoundMember> members;
+        std::map<std::string, const BoundMember*> elements;
+        std::map<std::string, const BoundMember*> attributes;
+    };
+
+    //thrown out of the SAX handler when a Python exception has been set
+    class PythonError {};
+
+    static std::map<std::string, BoundClass> boundClasses;
+    static PyObject *contentName = NULL;
+
+    static BoundClass *findClass(const std::string& name) {
+        std::map<std::string, BoundClass>::iterator it = boundClasses.find(name);
+
+        return it == boundClasses.end() ? NULL : &it->second;
+    }
+
+    static bool init(const ClassInfo *infos) {
+        xercesc::XMLPlatformUtils::Initialize();
+
+        if(!(contentName = JAMES_INTERN("content")))
+            return false;
+
+        for(const ClassInfo *info = infos; info->name; info++)
+            boundClasses[info->name].info = info;
+
+        //second pass, now that all classes exist
+        for(std::map<std::string, BoundClass>::iterator it = boundClasses.begin(); it != boundClasses.end(); it++) {
+            BoundClass& cl = it->second;
+            cl.type = NULL;
+
+            for(const Member *member = cl.info->members; member->name; member++) {
+                BoundMember bound;
+                bound.member = member;
+                bound.cl = member->className ? findClass(member->className) : NULL;
+
+                if(!(bound.name = JAMES_INTERN(member->name)))
+                    return false;
+
+                cl.members.push_back(bound);
+            }
+
+            //members won't move from here on
+            for(size_t x = 0; x < cl.members.size(); x++) {
+                if(cl.members[x].member->isAttribute)
+                    cl.attributes[cl.members[x].member->name] = &cl.members[x];
+                else
+                    cl.elements[cl.members[x].member->name] = &cl.members[x];
+            }
+        }
+
+        return true;
+    }
+
+    static BoundClass *classOf(PyObject *obj) {
+        PyObject *type = PyObject_GetAttrString(obj, "__class__");
+
+        if(!type)
+            return NULL;
+
+        PyObject *name = PyObject_GetAttrString(type, "__name__");
+        Py_DECREF(type);
+
+        if(!name)
+            return NULL;
+
+        PyObject *bytes = PyUnicode_Check(name) ? PyUnicode_AsUTF8String(name) : (Py_INCREF(name), name);
+        Py_DECREF(name);
+
+        if(!bytes)
+            return NULL;
+
+        BoundClass *cl = findClass(PyBytes_AsString(bytes));
+        Py_DECREF(bytes);
+
+        if(!cl)
+            PyErr_SetString(PyExc_TypeError, "object is not of a class known to this module");
+
+        return cl;
+    }
+
+    static PyObject *requireType(BoundClass *cl) {
+        if(!cl->type)
+            PyErr_Format(PyExc_RuntimeError, "class %s has not been registered", cl->info->name);
+
+        return cl->type;
+    }
+
+    /**
+     * Transcodes Xerces text to UTF-8, which is what convert() and the Python C API expect.
+     * XercesString would use the local code page instead.
+     */
+    static std::string toUTF8(const XMLCh *chars, XMLSize_t length) {
+        xercesc::TranscodeToStr utf8(chars, length, "UTF-8");
+
+        return std::string((const char*)utf8.str(), utf8.length());
+    }
+
+    static std::string toUTF8(const XMLCh *chars) {
+        return toUTF8(chars, xercesc::XMLString::stringLen(chars));
+    }
+
+#if PY_MAJOR_VERSION < 3
+    /**
+     * The str() converters of the generated code give ASCII text as str, which is kept.
+     * Other text is decoded to unicode like pyexpat does, rather than returned as UTF-8 bytes.
+     */
+    static PyObject *stringFromUTF8(const char *str, Py_ssize_t len) {
+        for(Py_ssize_t x = 0; x < len; x++)
+            if(str[x] & 0x80)
+                return PyUnicode_DecodeUTF8(str, len, NULL);
+
+        return PyString_FromStringAndSize(str, len);
+    }
+#endif
+
+    /**
+     * Converts text according to kind. Returns a new reference, or NULL on error.
+     */
+    static PyObject *convert(Kind kind, BoundClass *cl, const std::string& text) {
+        switch(kind) {
+        case STRING:
+            return JAMES_STRING_FROM(text.c_str(), text.size());
+        case INTERNED:
+            //XML text can't contain NUL characters
+            return JAMES_INTERN(text.c_str());
+        case INT:
+            return JAMES_INT_FROM(const_cast<char*>(text.c_str()));
+        case LONG:
+            return PyLong_FromString(const_cast<char*>(text.c_str()), NULL, 10);
+        case FLOAT: {
+            char *end;
+            double value = strtod(text.c_str(), &end);
+
+            if(end == text.c_str()) {
+                PyErr_Format(PyExc_ValueError, "could not convert string to float: %s", text.c_str());
+                return NULL;
+            }
+
+            return PyFloat_FromDouble(value);
+        }
+        case BOOL: {
+            std::string lower = text;
+
+            for(size_t x = 0; x < lower.size(); x++)
+                lower[x] = tolower(lower[x]);
+
+            PyObject *ret = (lower == "true" || lower == "1") ? Py_True : Py_False;
+            Py_INCREF(ret);
+            return ret;
+        }
+        case HEX: {
+            HexBinary hex;
+            std::istringstream iss(text);
+
+            iss >> hex;
+
+            return JAMES_BYTES_FROM((const char*)hex.getData(), hex.getSize());
+        }
+        case SIMPLE: {
+            if(!requireType(cl))
+                return NULL;
+
+            PyObject *str = JAMES_STRING_FROM(text.c_str(), text.size());
+
+            if(!str)
+                return NULL;
+
+            //N steals the reference to str
+            return PyObject_CallMethod(cl->type, const_cast<char*>("from_value"), const_cast<char*>("N"), str);
+        }
+        default:
+            PyErr_SetString(PyExc_RuntimeError, "cannot convert text of a complex member");
+            return NULL;
+        }
+    }
+
+    /**
+     * Sets or appends value to the given member of obj. Steals the reference to value.
+     */
+    static bool store(PyObject *obj, const BoundMember& member, PyObject *value) {
+        int ret;
+
+        if(member.member->isArray) {
+            PyObject *array = PyObject_GetAttr(obj, member.name);
+
+            if(!array) {
+                Py_DECREF(value);
+                return false;
+            }
+
+            if(PyList_CheckExact(array))
+                ret = PyList_Append(array, value);
+            else {
+                PyObject *result = PyObject_CallMethod(array, const_cast<char*>("append"), const_cast<char*>("O"), value);
+                ret = result ? 0 : -1;
+                Py_XDECREF(result);
+            }
+
+            Py_DECREF(array);
+        } else
+            ret = PyObject_SetAttr(obj, member.name, value);
+
+        Py_DECREF(value);
+
+        return ret == 0;
+    }
+
+    /**
+     * SAX2 handler that binds elements into objects using the BoundClass tables.
+     * Same state machine as ExpatBinder in JamesXMLObject.py.
+     */
+    class Binder : public xercesc::DefaultHandler {
+        struct Frame {
+            PyObject *obj;              //object being bound, or the parent of a text member
+            BoundClass *cl;             //NULL for text members and skipped elements
+            const BoundMember *text;    //set for text members
+        };
+
+        PyObject *root;
+        BoundClass *rootClass;
+        std::vector<Frame> stack;
+        std::basic_string<XMLCh> text;
+
+        void push(PyObject *obj, BoundClass *cl, const BoundMember *member) {
+            Frame frame;
+            frame.obj = obj;
+            frame.cl = cl;
+            frame.text = member;
+
+            Py_XINCREF(obj);
+            stack.push_back(frame);
+        }
+
+        void bindAttributes(PyObject *obj, BoundClass *cl, const xercesc::Attributes& attrs) {
+            for(XMLSize_t x = 0; x < attrs.getLength(); x++) {
+                std::map<std::string, const BoundMember*>::iterator it = cl->attributes.find(toUTF8(attrs.getQName(x)));
+
+                if(it == cl->attributes.end())
+                    continue;
+
+                PyObject *value = convert(it->second->member->kind, it->second->cl, toUTF8(attrs.getValue(x)));
+
+                if(!value || !store(obj, *it->second, value))
+                    throw PythonError();
+            }
+        }
+
+    public:
+        Binder(PyObject *root, BoundClass *rootClass) : root(root), rootClass(rootClass) {
+        }
+
+        ~Binder() {
+            for(size_t x = 0; x < stack.size(); x++)
+                Py_XDECREF(stack[x].obj);
+        }
+
+        void startElement(const XMLCh *const uri, const XMLCh *const localname, const XMLCh *const qname, const xercesc::Attributes& attrs) {
+            text.clear();
+            std::string name = toUTF8(localname);
+
+            if(stack.empty()) {
+                //like parsexml(), silently ignore documents with a non-matching root
+                if(name == rootClass->info->name) {
+                    bindAttributes(root, rootClass, attrs);
+                    push(root, rootClass, NULL);
+                } else
+                    push(NULL, NULL, NULL);
+
+                return;
+            }
+
+            Frame top = stack.back();
+
+            if(!top.cl) {
+                push(NULL, NULL, NULL);
+                return;
+            }
+
+            std::map<std::string, const BoundMember*>::iterator it = top.cl->elements.find(name);
+
+            if(it == top.cl->elements.end()) {
+                push(NULL, NULL, NULL);
+            } else if(it->second->member->kind != COMPLEX) {
+                push(top.obj, NULL, it->second);
+            } else {
+                BoundClass *cl = it->second->cl;
+
+                if(!requireType(cl))
+                    throw PythonError();
+
+                PyObject *child = PyObject_CallObject(cl->type, NULL);
+
+                if(!child)
+                    throw PythonError();
+
+                //the frame keeps its own reference, store() steals ours
+                push(child, cl, NULL);
+
+                if(!store(top.obj, *it->second, child))
+                    throw PythonError();
+
+                bindAttributes(child, cl, attrs);
+            }
+        }
+
+        void characters(const XMLCh *const chars, const XMLSize_t length) {
+            text.append(chars, length);
+        }
+
+        void endElement(const XMLCh *const uri, const XMLCh *const localname, const XMLCh *const qname) {
+            Frame frame = stack.back();
+            stack.pop_back();
+
+            PyObject *value = NULL;
+
+            if(frame.text) {
+                //text element - convert and store in the parent
+                if(!(value = convert(frame.text->member->kind, frame.text->cl, toUTF8(text.data(), text.size()))) || !store(frame.obj, *frame.text, value)) {
+                    Py_DECREF(frame.obj);
+                    throw PythonError();
+                }
+            } else if(frame.cl && frame.cl->info->content != NONE) {
+                //simple type or simpleContent
+                if(!(value = convert(frame.cl->info->content, NULL, toUTF8(text.data(), text.size()))) || PyObject_SetAttr(frame.obj, contentName, value)) {
+                    Py_XDECREF(value);
+                    Py_DECREF(frame.obj);
+                    throw PythonError();
+                }
+
+                Py_DECREF(value);
+            }
+
+            Py_XDECREF(frame.obj);
+        }
+
+        void fatalError(const xercesc::SAXParseException& e) {
+            PyErr_SetString(PyExc_ValueError, toUTF8(e.getMessage()).c_str());
+            throw PythonError();
+        }
+    };
+
+    static void escape(std::string& out, const char *str, Py_ssize_t len, bool lower) {
+        for(Py_ssize_t x = 0; x < len; x++) {
+            switch(str[x]) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            //same as xmlEscape(), so that line breaks in attributes survive
+            case '\n': out += "&#10;"; break;
+            case '\r': out += "&#13;"; break;
+            default: out += lower ? (char)tolower(str[x]) : str[x]; break;
+            }
+        }
+    }
+
+    /**
+     * Appends the escaped str() of value to out. Booleans in elements are lowercased, same as the generated appenders.
+     */
+    static bool writeValue(std::string& out, PyObject *value, bool lower) {
+        PyObject *str = PyObject_Str(value);
+
+        if(!str)
+            return false;
+
+#if PY_MAJOR_VERSION >= 3
+        Py_ssize_t len;
+        const char *data = PyUnicode_AsUTF8AndSize(str, &len);
+#else
+        Py_ssize_t len = PyString_Size(str);
+        const char *data = PyString_AsString(str);
+#endif
+
+        if(data)
+            escape(out, data, len, lower);
+
+        Py_DECREF(str);
+        return data != NULL;
+    }
+
+    static bool writeObject(std::string& out, PyObject *obj, BoundClass *cl, const char *name, const char *nameSpace);
+
+    static bool writeMember(std::string& out, PyObject *value, const BoundMember& member) {
+        if(member.member->kind == COMPLEX)
+            return writeObject(out, value, member.cl, member.member->name, NULL);
+
+        out += '<';
+        out += member.member->name;
+        out += '>';
+
+        if(!writeValue(out, value, member.member->kind == BOOL))
+            return false;
+
+        out += "</";
+        out += member.member->name;
+        out += '>';
+
+        return true;
+    }
+
+    /**
+     * Appends obj as an element called name. nameSpace is given for the root element only.
+     * Produces the same output as write_xml(): attributes sorted by name, which is also what toxml()
+     * gives before Python 3.8, and line breaks written as character references.
+     */
+    static bool writeObject(std::string& out, PyObject *obj, BoundClass *cl, const char *name, const char *nameSpace) {
+        out += '<';
+        out += name;
+
+        size_t x = 0;
+
+        for(; x < cl->members.size() && cl->members[x].member->isAttribute; x++) {
+            const BoundMember& member = cl->members[x];
+
+            if(nameSpace && strcmp(member.member->name, "xmlns") > 0) {
+                out += " xmlns=\"";
+                escape(out, nameSpace, strlen(nameSpace), false);
+                out += '"';
+                nameSpace = NULL;
+            }
+
+            PyObject *value = PyObject_GetAttr(obj, member.name);
+
+            if(!value)
+                return false;
+
+            if(value != Py_None) {
+                out += ' ';
+                out += member.member->name;
+                out += "=\"";
+
+                if(!writeValue(out, value, false)) {
+                    Py_DECREF(value);
+                    return false;
+                }
+
+                out += '"';
+            }
+
+            Py_DECREF(value);
+        }
+
+        if(nameSpace) {
+            out += " xmlns=\"";
+            escape(out, nameSpace, strlen(nameSpace), false);
+            out += '"';
+        }
+
+        out += '>';
+        size_t mark = out.size();
+
+        if(cl->info->content != NONE) {
+            PyObject *value = PyObject_GetAttr(obj, contentName);
+
+            if(!value || !writeValue(out, value, false)) {
+                Py_XDECREF(value);
+                return false;
+            }
+
+            Py_DECREF(value);
+        }
+
+        for(; x < cl->members.size(); x++) {
+            const BoundMember& member = cl->members[x];
+            PyObject *value = PyObject_GetAttr(obj, member.name);
+            bool ok = true;
+
+            if(!value)
+                return false;
+
+            if(value != Py_None) {
+                if(member.member->isArray) {
+                    PyObject *iter = PyObject_GetIter(value);
+                    PyObject *item;
+
+                    ok = iter != NULL;
+
+                    while(ok && (item = PyIter_Next(iter))) {
+                        ok = writeMember(out, item, member);
+                        Py_DECREF(item);
+                    }
+
+                    ok = ok && !PyErr_Occurred();
+                    Py_XDECREF(iter);
+                } else
+                    ok = writeMember(out, value, member);
+            }
+
+            Py_DECREF(value);
+
+            if(!ok)
+                return false;
+        }
+
+        if(out.size() == mark) {
+            //no children - same as minidom, close the tag directly
+            out.replace(mark - 1, 1, "/>");
+        } else {
+            out += "</";
+            out += name;
+            out += '>';
+        }
+
+        return true;
+    }
+
+    static PyObject *registerClass(PyObject *self, PyObject *type) {
+        PyObject *name = PyObject_GetAttrString(type, "__name__");
+
+        if(!name)
+            return NULL;
+
+        PyObject *bytes = PyUnicode_Check(name) ? PyUnicode_AsUTF8String(name) : (Py_INCREF(name), name);
+        Py_DECREF(name);
+
+        if(!bytes)
+            return NULL;
+
+        BoundClass *cl = findClass(PyBytes_AsString(bytes));
+        Py_DECREF(bytes);
+
+        //classes from other schemas are simply not handled natively
+        if(cl) {
+            Py_XDECREF(cl->type);
+            Py_INCREF(type);
+            cl->type = type;
+        }
+
+        Py_RETURN_NONE;
+    }
+
+    static PyObject *parse(PyObject *self, PyObject *args) {
+        PyObject *obj;
+        Py_buffer buffer;
+
+        //any object exporting a buffer (bytes, bytearray, memoryview, mmap) is parsed in place
+        if(!PyArg_ParseTuple(args, JAMES_BUFFER_FORMAT, &obj, &buffer))
+            return NULL;
+
+        BoundClass *cl = classOf(obj);
+
+        if(!cl) {
+            PyBuffer_Release(&buffer);
+            return NULL;
+        }
+
+        xercesc::SAX2XMLReader *reader = xercesc::XMLReaderFactory::createXMLReader();
+        Binder binder(obj, cl);
+        bool ok = true;
+
+        reader->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+        reader->setContentHandler(&binder);
+        reader->setErrorHandler(&binder);
+
+        try {
+            xercesc::MemBufInputSource source((const XMLByte*)buffer.buf, buffer.len, "_james_native");
+
+            reader->parse(source);
+        } catch(const PythonError&) {
+            ok = false;
+        } catch(const xercesc::XMLException& e) {
+            PyErr_SetString(PyExc_ValueError, toUTF8(e.getMessage()).c_str());
+            ok = false;
+        }
+
+        delete reader;
+        PyBuffer_Release(&buffer);
+
+        if(!ok)
+            return NULL;
+
+        Py_RETURN_NONE;
+    }
+
+    static PyObject *serialize(PyObject *self, PyObject *obj) {
+        BoundClass *cl = classOf(obj);
+
+        if(!cl)
+            return NULL;
+
+        PyObject *nameSpace = PyObject_CallMethod(obj, const_cast<char*>("get_namespace"), NULL);
+
+        if(!nameSpace)
+            return NULL;
+
+        PyObject *nameSpaceBytes = PyUnicode_Check(nameSpace) ? PyUnicode_AsUTF8String(nameSpace) : (Py_INCREF(nameSpace), nameSpace);
+        Py_DECREF(nameSpace);
+
+        if(!nameSpaceBytes)
+            return NULL;
+
+        std::string out = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+        bool ok = writeObject(out, obj, cl, cl->info->name, PyBytes_AsString(nameSpaceBytes));
+
+        Py_DECREF(nameSpaceBytes);
+
+        return ok ? JAMES_BYTES_FROM(out.c_str(), out.size()) : NULL;
+    }
+
+    static PyMethodDef methods[] = {
+        {"register", registerClass, METH_O, "Registers a generated class so that it can be instantiated while parsing"},
+        {"parse", parse, METH_VARARGS, "parse(obj, data) - binds the document in data (any bytes-like object) into obj"},
+        {"serialize", serialize, METH_O, "Returns obj marshalled as an XML document"},
+        {NULL, NULL, 0, NULL}
+    };
+}
+}
+
+#if PY_MAJOR_VERSION >= 3
+#define JAMES_NATIVE_MODULE(name, infos) \
+    static struct PyModuleDef name##_definition = {PyModuleDef_HEAD_INIT, #name, NULL, -1, james::native::methods}; \
+    PyMODINIT_FUNC PyInit_##name(void) { \
+        if(!james::native::init(infos)) \
+            return NULL; \
+        return PyModule_Create(&name##_definition); \
+    }
+#else
+#define JAMES_NATIVE_MODULE(name, infos) \
+    PyMODINIT_FUNC init##name(void) { \
+        if(james::native::init(infos)) \
+            Py_InitModule(#name, james::native::methods); \
+    }
+#endif
+
+#endif /* _JAMESNATIVE_H */
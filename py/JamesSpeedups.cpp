@@ -0,0 +1,339 @@
+/* This file is in the public domain.
+ *
+ * File:   JamesSpeedups.cpp
+ *
+ * Optional CPython extension module _james_speedups, with C++ versions of the
+ * helpers in JamesXMLObject.py that the generated code calls for every value:
+ * strToBool(), strToHex(), xmlEscape() and getText(). JamesXMLObject.py
+ * replaces its pure Python versions with these whenever the module can be
+ * imported. Build it with cmake -DBUILD_SPEEDUPS=ON and put the result next
+ * to JamesXMLObject.py.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <vector>
+
+#if PY_MAJOR_VERSION >= 3
+#define JAMES_BYTES_FROM(str, len) PyBytes_FromStringAndSize(str, len)
+#define JAMES_EMPTY_STRING() PyUnicode_FromStringAndSize(NULL, 0)
+#define JAMES_INTERN(str) PyUnicode_InternFromString(str)
+#define JAMES_HEX_ERROR PyExc_ValueError
+#else
+#define JAMES_BYTES_FROM(str, len) PyString_FromStringAndSize(str, len)
+#define JAMES_EMPTY_STRING() PyString_FromStringAndSize(NULL, 0)
+#define JAMES_INTERN(str) PyString_InternFromString(str)
+#define JAMES_HEX_ERROR PyExc_TypeError
+#endif
+
+namespace james {
+namespace speedups {
+    static PyObject *firstChildName = NULL;
+    static PyObject *nextSiblingName = NULL;
+    static PyObject *nodeValueName = NULL;
+    static PyObject *nodeTypeName = NULL;
+
+    /**
+     * The characters of a str, bytes or unicode object, without copying them.
+     */
+    struct Chars {
+        PyObject *obj;
+        int width;          //bytes per character: 1, 2 or 4
+        const void *data;
+        Py_ssize_t length;
+        bool isUnicode;
+    };
+
+    static bool getChars(PyObject *obj, Chars& chars) {
+        chars.obj = obj;
+
+        if(PyUnicode_Check(obj)) {
+#if PY_MAJOR_VERSION >= 3
+            if(PyUnicode_READY(obj) < 0)
+                return false;
+
+            chars.width = PyUnicode_KIND(obj);
+            chars.data = PyUnicode_DATA(obj);
+            chars.length = PyUnicode_GET_LENGTH(obj);
+#else
+            chars.width = sizeof(Py_UNICODE);
+            chars.data = PyUnicode_AS_UNICODE(obj);
+            chars.length = PyUnicode_GET_SIZE(obj);
+#endif
+            chars.isUnicode = true;
+            return true;
+        } else if(PyBytes_Check(obj)) {
+            chars.width = 1;
+            chars.data = PyBytes_AS_STRING(obj);
+            chars.length = PyBytes_GET_SIZE(obj);
+            chars.isUnicode = false;
+            return true;
+        }
+
+        PyErr_Format(PyExc_TypeError, "expected a string, got %.200s", Py_TYPE(obj)->tp_name);
+        return false;
+    }
+
+    template<typename Char> static bool isTrue(const Char *str, Py_ssize_t length) {
+        //"1" or "true" in any case, same as strToBool()
+        const char *lower = "true";
+
+        if(length == 1)
+            return str[0] == '1';
+        else if(length != 4)
+            return false;
+
+        for(Py_ssize_t x = 0; x < length; x++) {
+            Char c = str[x];
+
+            if(c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+
+            if(c != (Char)lower[x])
+                return false;
+        }
+
+        return true;
+    }
+
+    static PyObject *strToBool(PyObject *self, PyObject *obj) {
+        Chars chars;
+        bool ret;
+
+        if(!getChars(obj, chars))
+            return NULL;
+
+        switch(chars.width) {
+        case 1: ret = isTrue((const unsigned char*)chars.data, chars.length); break;
+        case 2: ret = isTrue((const unsigned short*)chars.data, chars.length); break;
+        default: ret = isTrue((const unsigned int*)chars.data, chars.length); break;
+        }
+
+        return PyBool_FromLong(ret);
+    }
+
+    static int hexValue(unsigned int c) {
+        if(c >= '0' && c <= '9')
+            return c - '0';
+        else if(c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        else
+            return -1;
+    }
+
+    template<typename Char> static PyObject *unhexlify(const Char *str, Py_ssize_t length) {
+        //same errors as binascii.unhexlify()
+        if(length % 2) {
+            PyErr_SetString(JAMES_HEX_ERROR, "Odd-length string");
+            return NULL;
+        }
+
+        std::vector<char> out(length / 2 + 1);
+
+        for(Py_ssize_t x = 0; x < length; x += 2) {
+            int high = hexValue(str[x]), low = hexValue(str[x + 1]);
+
+            if(high < 0 || low < 0) {
+                PyErr_SetString(JAMES_HEX_ERROR, "Non-hexadecimal digit found");
+                return NULL;
+            }
+
+            out[x / 2] = (char)(high << 4 | low);
+        }
+
+        return JAMES_BYTES_FROM(&out[0], length / 2);
+    }
+
+    static PyObject *strToHex(PyObject *self, PyObject *obj) {
+        Chars chars;
+
+        if(!getChars(obj, chars))
+            return NULL;
+
+        switch(chars.width) {
+        case 1: return unhexlify((const unsigned char*)chars.data, chars.length);
+        case 2: return unhexlify((const unsigned short*)chars.data, chars.length);
+        default: return unhexlify((const unsigned int*)chars.data, chars.length);
+        }
+    }
+
+    static const char *escapeOf(unsigned int c) {
+        switch(c) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '"': return "&quot;";
+        case '>': return "&gt;";
+        case '\n': return "&#10;";
+        case '\r': return "&#13;";
+        default: return NULL;
+        }
+    }
+
+    template<typename Char> static PyObject *escape(const Chars& chars) {
+        const Char *str = (const Char*)chars.data;
+        Py_ssize_t x = 0;
+
+        //most values need no escaping at all, and are returned as they are
+        while(x < chars.length && !escapeOf(str[x]))
+            x++;
+
+        if(x == chars.length) {
+            Py_INCREF(chars.obj);
+            return chars.obj;
+        }
+
+        std::vector<Char> out(str, str + x);
+        out.reserve(chars.length + 16);
+
+        for(; x < chars.length; x++) {
+            const char *entity = escapeOf(str[x]);
+
+            if(entity) {
+                for(; *entity; entity++)
+                    out.push_back((Char)*entity);
+            } else
+                out.push_back(str[x]);
+        }
+
+        if(!chars.isUnicode)
+            return JAMES_BYTES_FROM((const char*)&out[0], out.size());
+
+#if PY_MAJOR_VERSION >= 3
+        return PyUnicode_FromKindAndData(sizeof(Char), &out[0], out.size());
+#else
+        return PyUnicode_FromUnicode((const Py_UNICODE*)&out[0], out.size());
+#endif
+    }
+
+    static PyObject *xmlEscape(PyObject *self, PyObject *obj) {
+        Chars chars;
+
+        if(!getChars(obj, chars))
+            return NULL;
+
+        switch(chars.width) {
+        case 1: return escape<unsigned char>(chars);
+        case 2: return escape<unsigned short>(chars);
+        default: return escape<unsigned int>(chars);
+        }
+    }
+
+    /**
+     * Joins the text and CDATA section children of the node whose first child is child. Steals the reference to child.
+     */
+    static PyObject *joinText(PyObject *child) {
+        PyObject *parts = PyList_New(0);
+
+        while(parts && child != Py_None) {
+            PyObject *type = PyObject_GetAttr(child, nodeTypeName);
+            long value = type ? PyLong_AsLong(type) : -1;
+
+            Py_XDECREF(type);
+
+            if(value == -1 && PyErr_Occurred()) {
+                Py_CLEAR(parts);
+                break;
+            }
+
+            //TEXT_NODE and CDATA_SECTION_NODE
+            if(value == 3 || value == 4) {
+                PyObject *text = PyObject_GetAttr(child, nodeValueName);
+
+                if(!text || PyList_Append(parts, text)) {
+                    Py_XDECREF(text);
+                    Py_CLEAR(parts);
+                    break;
+                }
+
+                Py_DECREF(text);
+            }
+
+            PyObject *next = PyObject_GetAttr(child, nextSiblingName);
+            Py_DECREF(child);
+            child = next;
+
+            if(!child)
+                Py_CLEAR(parts);
+        }
+
+        Py_XDECREF(child);
+
+        if(!parts)
+            return NULL;
+
+        PyObject *empty = PyUnicode_FromStringAndSize(NULL, 0);
+        PyObject *ret = empty ? PyUnicode_Join(empty, parts) : NULL;
+
+        Py_XDECREF(empty);
+        Py_DECREF(parts);
+
+        return ret;
+    }
+
+    static PyObject *getText(PyObject *self, PyObject *node) {
+        PyObject *child = PyObject_GetAttr(node, firstChildName);
+
+        if(!child)
+            return NULL;
+
+        if(child == Py_None) {
+            Py_DECREF(child);
+            return JAMES_EMPTY_STRING();
+        }
+
+        PyObject *next = PyObject_GetAttr(child, nextSiblingName);
+
+        if(!next) {
+            Py_DECREF(child);
+            return NULL;
+        }
+
+        //the common case of a single text node
+        if(next == Py_None) {
+            PyObject *value = PyObject_GetAttr(child, nodeValueName);
+
+            Py_DECREF(next);
+            Py_DECREF(child);
+
+            return value;
+        }
+
+        Py_DECREF(next);
+
+        return joinText(child);
+    }
+
+    static bool init() {
+        return (firstChildName = JAMES_INTERN("firstChild")) &&
+               (nextSiblingName = JAMES_INTERN("nextSibling")) &&
+               (nodeValueName = JAMES_INTERN("nodeValue")) &&
+               (nodeTypeName = JAMES_INTERN("nodeType"));
+    }
+
+    static PyMethodDef methods[] = {
+        {"strToBool", strToBool, METH_O, "Returns True if the string is \"1\" or \"true\" in any case"},
+        {"strToHex", strToHex, METH_O, "Returns the bytes of a string of hexadecimal digits"},
+        {"xmlEscape", xmlEscape, METH_O, "Escapes a string for use in XML text or attribute values, including line breaks"},
+        {"getText", getText, METH_O, "Returns the text content of a minidom element without child elements"},
+        {NULL, NULL, 0, NULL}
+    };
+}
+}
+
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef _james_speedups_definition = {PyModuleDef_HEAD_INIT, "_james_speedups", NULL, -1, james::speedups::methods};
+
+PyMODINIT_FUNC PyInit__james_speedups(void) {
+    if(!james::speedups::init())
+        return NULL;
+
+    return PyModule_Create(&_james_speedups_definition);
+}
+#else
+PyMODINIT_FUNC init_james_speedups(void) {
+    if(james::speedups::init())
+        Py_InitModule("_james_speedups", james::speedups::methods);
+}
+#endif
@@ -13,8 +13,819 @@
 # limitations under the License.
 
 from xml.dom.minidom import *
+import xml.parsers.expat
+import struct
+import mmap
+import os
+import re
+import binascii
+from array import array
+from timeit import default_timer
+
+try:
+    intern
+except NameError:
+    from sys import intern
+
+#the generated code converts long and unsignedLong values with long(), which is int on Python 3
+try:
+    long
+except NameError:
+    long = int
+
+#extension module generated by pyjames --native, if it has been built
+try:
+    import _james_native as native
+except ImportError:
+    native = None
+
+def registerNative(cls):
+    if native != None:
+        native.register(cls)
+
+def strToBool(string):
+    if(string.lower() == "true" or string == "1"):
+        return True
+    return False
+
+def strToInterned(string):
+    #members and types given to pyjames --intern share a single copy of each distinct value
+    return intern(str(string))
+
+def strToHex(string):
+    return binascii.unhexlify(string)
+
+def xmlEscape(string):
+    #same escaping as minidom, plus line breaks so that documents never span multiple lines
+    return string.replace("&", "&amp;").replace("<", "&lt;").replace("\"", "&quot;").replace(">", "&gt;").replace("\n", "&#10;").replace("\r", "&#13;")
+
+def getText(node):
+    #text content of an element without child elements, which minidom splits into several nodes around CDATA sections
+    child = node.firstChild
+    if child == None:
+        return ""
+    if child.nextSibling == None:
+        return child.nodeValue
+    return "".join([c.nodeValue for c in node.childNodes if c.nodeType in (Node.TEXT_NODE, Node.CDATA_SECTION_NODE)])
+
+#C++ versions of the helpers above, built from py/JamesSpeedups.cpp, if available
+try:
+    from _james_speedups import *
+except ImportError:
+    pass
+
+def totalDigits(value):
+    #number of significant digits of a number for the totalDigits facet, not counting leading zeros or trailing decimal zeros
+    digits = str(abs(value))
+    if "." in digits:
+        digits = digits.rstrip("0")
+    return max(len(digits.replace(".", "").lstrip("0")), 1)
+
+def mapFile(filename):
+    """
+    Maps filename read-only into memory, so that the parsers read the page cache directly instead of a copy.
+    Empty files can't be mapped and are returned as an empty string.
+    """
+    f = open(filename, "rb")
+    try:
+        if os.fstat(f.fileno()).st_size == 0:
+            return b""
+        return mmap.mmap(f.fileno(), 0, access = mmap.ACCESS_READ)
+    finally:
+        f.close()
+
+class BufferReader:
+    """
+    File-like object reading a memoryview a chunk at a time,
+    for the parsers that can't take writable or sliced buffers directly.
+    """
+    def __init__(self, view):
+        self.view = view
+        self.pos = 0
+
+    def read(self, size = -1):
+        if size < 0:
+            size = len(self.view) - self.pos
+        chunk = self.view[self.pos:self.pos + size].tobytes()
+        self.pos += len(chunk)
+        return chunk
+
+class ChunkedWriter:
+    """
+    Collects the pieces passed to write() and hands them to stream.write()
+    joined into chunks of at least chunk_size characters.
+    """
+    def __init__(self, stream, chunk_size):
+        self.stream = stream
+        self.chunk_size = chunk_size
+        self.parts = []
+        self.size = 0
+
+    def write(self, data):
+        self.parts.append(data)
+        self.size += len(data)
+        if self.size >= self.chunk_size:
+            self.flush()
+
+    def flush(self):
+        if self.parts:
+            self.stream.write("".join(self.parts))
+            self.parts = []
+            self.size = 0
+
+xmlDeclaration = '<?xml version="1.0" encoding="UTF-8"?>'
+
+#stack frame for elements whose contents are of no interest
+skipFrame = (None, None, None)
+
+class ExpatBinder:
+    """
+    Binds a document straight into generated objects from pyexpat events,
+    without building an intermediate DOM tree.
+    What to do with each element and attribute is looked up in the tables
+    returned by the expat_tables() method of each generated class.
+
+    The tables of the root can be replaced by those of a Projection, binding only part of the document.
+
+    The stack holds one (object, elements, extra) tuple per open element:
+     - (obj, elements, content) for complex elements
+     - (obj, None, entry) for elements whose text is converted into a member of obj
+     - skipFrame for elements that are ignored
+    """
+    def __init__(self, root, tables = None):
+        self.root = root
+        self.tables = tables or root.__class__
+        self.stack = []
+        self.text = []
+        self.parser = xml.parsers.expat.ParserCreate()
+        self.parser.buffer_text = True
+        self.parser.StartElementHandler = self.start_root
+        self.parser.EndElementHandler = self.end_element
+        self.parser.CharacterDataHandler = self.text.append
+
+    def parse(self, xml):
+        if hasattr(xml, "read"):
+            self.parser.ParseFile(xml)
+        else:
+            data = mapFile(xml)
+            try:
+                self.parser.Parse(data, True)
+            finally:
+                if isinstance(data, mmap.mmap):
+                    data.close()
+
+        return self.root
+
+    def parse_buffer(self, data):
+        """Parses a document held in bytes, bytearray, memoryview or mmap"""
+        if isinstance(data, (bytearray, memoryview)):
+            self.parser.ParseFile(BufferReader(memoryview(data)))
+        else:
+            self.parser.Parse(data, True)
+
+        return self.root
+
+    def push_object(self, obj, cls, attributes):
+        elements, attributeTable, content = cls.expat_tables()
+
+        for name, value in attributes.items():
+            entry = attributeTable.get(name)
+            if entry != None:
+                setattr(obj, entry[0], entry[1](value))
+
+        self.stack.append((obj, elements, content))
+
+    def start_root(self, name, attributes):
+        #like parsexml(), silently ignore documents with a non-matching root
+        self.parser.StartElementHandler = self.start_element
+        del self.text[:]
+
+        if name[name.rfind(":") + 1:] == self.root.get_name():
+            self.push_object(self.root, self.tables, attributes)
+        else:
+            self.stack.append(skipFrame)
+
+    def start_element(self, name, attributes):
+        del self.text[:]
+        obj, elements, extra = self.stack[-1]
+
+        if elements == None:
+            self.stack.append(skipFrame)
+            return
+
+        entry = elements.get(name[name.rfind(":") + 1:])
+
+        if entry == None:
+            self.stack.append(skipFrame)
+        elif entry[3] == None:
+            self.stack.append((obj, None, entry))
+        else:
+            child = entry[3]()
+
+            if entry[1]:
+                getattr(obj, entry[0]).append(child)
+            else:
+                setattr(obj, entry[0], child)
+
+            self.push_object(child, entry[3], attributes)
+
+    def end_element(self, name):
+        obj, elements, extra = self.stack.pop()
+
+        if extra == None:
+            return
+
+        if elements == None:
+            #text element - convert and store in the parent
+            value = extra[2]("".join(self.text))
+
+            if extra[1]:
+                getattr(obj, extra[0]).append(value)
+            else:
+                setattr(obj, extra[0], value)
+        else:
+            #complex element with simpleContent
+            obj.content = extra("".join(self.text))
+
+class IncrementalParser:
+    """
+    Binds a document handed over a piece at a time with feed(), as it arrives from a socket or a stream,
+    using the expat backend. Objects are bound as their elements are parsed, so only the current piece is held in memory.
+    Returned by the incremental_parser() of the generated document classes.
+    """
+    def __init__(self, root, validate = False):
+        self.binder = root.expat_binder(root)
+        self.validate = validate
+
+    def feed(self, data):
+        """Parses the next piece of the document, in bytes, bytearray or memoryview"""
+        if isinstance(data, (bytearray, memoryview)):
+            data = bytes(data)
+
+        self.binder.parser.Parse(data, False)
+
+    def close(self):
+        """Finishes the document and returns the bound object. Raises xml.parsers.expat.ExpatError if it is incomplete"""
+        self.binder.parser.Parse(b"", True)
+
+        if self.validate:
+            self.binder.root.validate()
+
+        return self.binder.root
+
+class DocumentBinder(ExpatBinder):
+    """
+    ExpatBinder used by the parse_any() of the generated JamesDocuments module, which creates the root object
+    with the class that documents maps the namespace and local name of the root element to.
+    """
+    def __init__(self, documents):
+        ExpatBinder.__init__(self, None)
+        self.documents = documents
+
+    def start_root(self, name, attributes):
+        prefix, colon, localName = name.rpartition(":")
+        namespace = attributes.get("xmlns:" + prefix if prefix else "xmlns", "")
+        cls = self.documents.get((namespace, localName))
+
+        if cls == None:
+            raise ValueError("No document class for {%s}%s" % (namespace, localName))
+
+        self.root = cls()
+        self.tables = cls
+        ExpatBinder.start_root(self, name, attributes)
+
+class Projection:
+    """
+    Stands in for a generated class in the expat_tables() of ExpatBinder, with tables that only hold some of its members.
+    Elements that aren't in the tables are skipped by ExpatBinder without being bound.
+    """
+    def __init__(self, cls, tree):
+        elements, attributes, content = cls.expat_tables()
+        self.cls = cls
+        self.tables = ({}, {}, None)
+
+        for name, subtree in tree.items():
+            if name in elements:
+                entry = elements[name]
+
+                if subtree:
+                    if entry[3] == None:
+                        raise ValueError(cls.__name__ + "." + name + " has no members")
+                    entry = (entry[0], entry[1], entry[2], Projection(entry[3], subtree))
+
+                self.tables[0][name] = entry
+            elif name in attributes and not subtree:
+                self.tables[1][name] = attributes[name]
+            elif name == "content" and content != None and not subtree:
+                self.tables = (self.tables[0], self.tables[1], content)
+            else:
+                raise ValueError(cls.__name__ + " has no member " + name)
+
+    def __call__(self):
+        return self.cls()
+
+    def expat_tables(self):
+        return self.tables
+
+#compiled projections by class and fields
+projections = {}
+
+def getProjection(cls, fields):
+    """
+    Returns the Projection of cls binding only the given fields.
+    Each field is a path of member names separated by dots, like "person.address". Whole subtrees are bound below the last one.
+    """
+    key = (cls, tuple(fields))
+
+    if key not in projections:
+        tree = {}
+        for field in fields:
+            node = tree
+            for name in field.split("."):
+                node = node.setdefault(name, {})
+
+        projections[key] = Projection(cls, tree)
+
+    return projections[key]
+
+def getColumnClass(cls, member):
+    """Returns the element name and the class of the items of the array member of cls, which must be of a complex type"""
+    for name, entry in cls.expat_tables()[0].items():
+        if entry[0] == member and entry[1] and entry[3] != None:
+            return name, entry[3]
+
+    raise ValueError("%s has no array of complex elements called %s" % (cls.__name__, member))
+
+class ColumnBinder(ExpatBinder):
+    """
+    ExpatBinder that turns the items of an array member of the root into columns rather than objects, see iter_columns().
+    The simple members listed by the column_specs() of the item type are converted straight from the text of their
+    elements and attributes into the current row, and everything else inside the items is skipped.
+    The other members of the root are bound as usual.
+
+    Every batch_size items the columns are moved to batches as a dict, like the one returned by to_columns().
+    """
+    def __init__(self, root, member, batch_size):
+        ExpatBinder.__init__(self, root)
+        self.element, itemClass = getColumnClass(root.__class__, member)
+        self.specs = itemClass.column_specs()
+        self.batch_size = batch_size
+        self.batches = []
+        self.row = None
+        self.depth = 0
+        self.field = None
+
+        #(column index, converter) of each attribute, element and the text content of the items
+        self.attributeFields = {}
+        self.elementFields = {}
+        self.contentField = None
+        self.required = []
+
+        for index, (name, isAttribute, typecode, converter) in enumerate(self.specs):
+            if isAttribute == None:
+                self.contentField = (index, converter)
+            elif isAttribute:
+                self.attributeFields[name] = (index, converter)
+            else:
+                self.elementFields[name] = (index, converter)
+
+            if typecode:
+                self.required.append(index)
+
+        self.new_columns()
+
+    def new_columns(self):
+        self.columns = [array(typecode) if typecode else [] for name, isAttribute, typecode, converter in self.specs]
+        self.count = 0
+
+    def flush(self):
+        """Moves the items bound since the last batch to batches"""
+        if self.count:
+            self.batches.append(dict((spec[0], column) for spec, column in zip(self.specs, self.columns)))
+            self.new_columns()
+
+    def start_element(self, name, attributes):
+        localName = name[name.rfind(":") + 1:]
+        del self.text[:]
+
+        if self.row != None:
+            #inside an item, only its child elements are looked at
+            self.depth += 1
+            self.field = self.elementFields.get(localName) if self.depth == 1 else None
+        elif localName == self.element and len(self.stack) == 1 and self.stack[0][0] is self.root:
+            row = self.row = [None] * len(self.specs)
+            self.depth = 0
+
+            for attribute, value in attributes.items():
+                field = self.attributeFields.get(attribute)
+                if field != None:
+                    row[field[0]] = field[1](value)
+        else:
+            ExpatBinder.start_element(self, name, attributes)
+
+    def end_element(self, name):
+        if self.row == None:
+            ExpatBinder.end_element(self, name)
+        elif self.depth:
+            if self.field != None:
+                self.row[self.field[0]] = self.field[1]("".join(self.text))
+                self.field = None
+
+            self.depth -= 1
+        else:
+            self.end_item()
+
+    def end_item(self):
+        row = self.row
+        self.row = None
+
+        if self.contentField != None:
+            row[self.contentField[0]] = self.contentField[1]("".join(self.text))
+
+        for index in self.required:
+            if row[index] == None:
+                raise ValueError("%s without %s" % (self.element, self.specs[index][0]))
+
+        for column, value in zip(self.columns, row):
+            column.append(value)
+
+        self.count += 1
+        if self.count >= self.batch_size:
+            self.flush()
+
+#size of the pieces fed to pyexpat when parsing part of a mapped file
+parseChunkSize = 1 << 20
+
+def parseChunk(task):
+    """
+    Binds part of a document in a worker process of parsexml_parallel().
+    The part is parsed as if it were the only content of the root element.
+    """
+    cls, filename, header, start, end, footer = task
+    binder = ExpatBinder(cls())
+    data = mapFile(filename)
+
+    try:
+        binder.parser.Parse(header, False)
+        for pos in range(start, end, parseChunkSize):
+            binder.parser.Parse(data[pos:min(pos + parseChunkSize, end)], False)
+        binder.parser.Parse(footer, True)
+    finally:
+        data.close()
+
+    return binder.root
+
+def findSplit(data, item, start, pos, end):
+    """
+    Returns the position of the first match of item in data[pos:end] that isn't inside a comment, CDATA section or
+    processing instruction begun after start, or None. Matches inside nested elements aren't caught here,
+    they make the worker parsing the chunk before them fail.
+    """
+    while True:
+        match = item.search(data, pos, end)
+        if match == None:
+            return None
+
+        pos = match.start()
+        for begin, finish in ((b"<!--", b"-->"), (b"<![CDATA[", b"]]>"), (b"<?", b"?>")):
+            markup = data.rfind(begin, start, pos)
+            if markup != -1 and data.find(finish, markup + len(begin), pos) == -1:
+                pos = data.find(finish, pos, end)
+                if pos == -1:
+                    return None
+                break
+        else:
+            return match.start()
+
+def openCacheDir(cache_dir):
+    """
+    Returns the directory fromxml_cached() keeps its pickles in, creating it with mode 0700 if needed.
+    Defaults to pyjames under $XDG_CACHE_HOME or ~/.cache. Since loading a pickle can run any code,
+    a directory that isn't owned by the current user, or that others can write to, raises ValueError.
+    """
+    if cache_dir == None:
+        base = os.environ.get("XDG_CACHE_HOME") or os.path.join(os.path.expanduser("~"), ".cache")
+        cache_dir = os.path.join(base, "pyjames")
+
+    if not os.path.isdir(cache_dir):
+        try:
+            os.makedirs(cache_dir, 0o700)
+        except OSError:
+            #created by another process in the meantime, checked below
+            if not os.path.isdir(cache_dir):
+                raise
+
+    #ownership and permissions mean nothing on Windows
+    if hasattr(os, "getuid"):
+        stat = os.lstat(cache_dir)
+        if stat.st_uid != os.getuid() or stat.st_mode & 0o022 or os.path.islink(cache_dir):
+            raise ValueError("Refusing to use cache directory " + cache_dir +
+                             ", which is a link, isn't owned by the current user or is writable by others")
+
+    return cache_dir
+
+def stateFingerprint(cls):
+    """
+    Describes the pickled state of cls and of every complex class reachable from it, including the options
+    they were generated with that change the types of the values (_state_format), so that objects cached by
+    fromxml_cached() aren't loaded into classes that have since been regenerated.
+    """
+    seen = set()
+    parts = []
+    todo = [cls]
+
+    while todo:
+        c = todo.pop()
+        if c in seen:
+            continue
+
+        seen.add(c)
+        parts.append(c.__name__ + "(" + ",".join(c._state_members) + ")" + c._state_format)
+
+        for entry in c.expat_tables()[0].values():
+            if entry[3] != None:
+                todo.append(entry[3])
+
+    return ";".join(sorted(parts))
+
+def bindLazy(self, name):
+    """
+    __getattr__() of classes generated with --lazy.
+    Binds a member whose element parse_node() only recorded, the first time it is read.
+    """
+    pending = self.__dict__.get("_pending")
+    if pending == None or name not in pending:
+        raise AttributeError(name)
+
+    bind, nodes = pending.pop(name)
+    if isinstance(nodes, list):
+        value = [bind(node) for node in nodes]
+        if getattr(self, "_tracked", False):
+            value = TrackedList(self, value)
+    else:
+        value = bind(nodes)
+
+    self.__dict__[name] = value
+    return value
+
+def markChanged(obj):
+    """Drops the XML text kept by writeCached() for obj and the objects above it"""
+    while obj != None:
+        d = obj.__dict__
+        if d.get("_xml") != None:
+            d["_xml"] = None
+        elif "_xml" in d:
+            #already changed since it was last written, and so are the objects above it
+            break
+
+        obj = d.get("_parent")
+
+class TrackedList(list):
+    """
+    List of an array member of a class generated with --dirty.
+    Changing it marks its owner as changed, see markChanged().
+    """
+    def __init__(self, owner, items = ()):
+        list.__init__(self, items)
+        self.owner = owner
+
+    def __reduce__(self):
+        return (list, (list(self),))
+
+def trackedMethod(name):
+    method = getattr(list, name)
+    def changing(self, *args, **kwargs):
+        ret = method(self, *args, **kwargs)
+        markChanged(self.owner)
+        return ret
+    changing.__name__ = name
+    return changing
+
+for name in ("append", "extend", "insert", "pop", "remove", "reverse", "sort", "__setitem__", "__delitem__",
+             "__iadd__", "__imul__", "__setslice__", "__delslice__"):
+    if hasattr(list, name):
+        setattr(TrackedList, name, trackedMethod(name))
+
+def setTracked(self, name, value):
+    """
+    __setattr__() of classes generated with --dirty.
+    Lists are copied into a TrackedList, and the object is marked as changed.
+    """
+    if type(value) == list or (type(value) == TrackedList and value.owner is not self):
+        value = TrackedList(self, value)
+
+    self.__dict__[name] = value
+    markChanged(self)
+
+def writeCached(self, write, name, xmlns = None):
+    """
+    write_xml() of classes generated with --dirty.
+    Writes the XML text rendered by render_xml() the last time, unless the object or one below it has changed since.
+    """
+    d = self.__dict__
+    cached = d.get("_xml")
+
+    if cached == None or cached[0] != name or cached[1] != xmlns:
+        parts = []
+        self.render_xml(parts.append, name, xmlns)
+        cached = d["_xml"] = (name, xmlns, "".join(parts))
+
+        #the children just written report their changes back to this object
+        for member in self._state_members:
+            value = d.get(member)
+            if isinstance(value, list):
+                if value and getattr(value[0], "_tracked", False):
+                    for item in value:
+                        item.__dict__["_parent"] = self
+            elif getattr(value, "_tracked", False):
+                value.__dict__["_parent"] = self
+
+    write(cached[2])
+
+def toxmlCached(self):
+    """
+    toxml() of classes generated with --dirty, which goes through write_document() to reuse the cached XML text.
+    Unlike minidom, line breaks in attribute values are written as character references.
+    """
+    parts = []
+    self.write_document(parts.append)
+    data = "".join(parts)
+    return data if isinstance(data, bytes) else data.encode("utf-8")
+
+class Counters:
+    """
+    What the objects of a class generated with --instrument have been doing, see snapshotCounters().
+    The times of parse_node(), append_children() and write_xml() include those of the child objects.
+    """
+    fields = ("objects", "elements", "parse_seconds", "write_seconds", "bytes_in", "bytes_out")
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        for name in self.fields:
+            setattr(self, name, 0)
+
+    def snapshot(self):
+        return dict((name, getattr(self, name)) for name in self.fields)
+
+#Counters of each class generated with --instrument
+counters = {}
+
+def snapshotCounters(reset = False):
+    """
+    Returns the counters of the classes generated with --instrument that have been used, as a dict of dicts keyed by class name.
+    With reset the counters start over from zero.
+    """
+    snapshot = {}
+
+    for cls, c in counters.items():
+        values = c.snapshot()
+        if any(values.values()):
+            snapshot[cls.__name__] = values
+        if reset:
+            c.reset()
+
+    return snapshot
+
+class CountingExpatBinder(ExpatBinder):
+    """
+    ExpatBinder of classes generated with --instrument, which counts the child elements of the objects it binds
+    and adds the time taken by the whole document to the parse_seconds of the root.
+    """
+    def start_element(self, name, attributes):
+        obj, elements, extra = self.stack[-1]
+
+        if elements != None:
+            c = counters.get(obj.__class__)
+            if c != None:
+                c.elements += 1
+
+        ExpatBinder.start_element(self, name, attributes)
+
+    def timed(self, parse, xml):
+        start = default_timer()
+        try:
+            return parse(self, xml)
+        finally:
+            c = counters.get(self.root.__class__)
+            if c != None:
+                c.parse_seconds += default_timer() - start
+
+    def parse(self, xml):
+        return self.timed(ExpatBinder.parse, xml)
+
+    def parse_buffer(self, data):
+        return self.timed(ExpatBinder.parse_buffer, data)
+
+def fileSize(xml):
+    try:
+        return os.path.getsize(xml)
+    except (TypeError, OSError):
+        #file objects
+        return 0
+
+def countInlined(cls, node):
+    """
+    Counts the child elements of node as bound into an object of cls, for the parse_node() of document classes
+    generated with both --inline-depth and --instrument, which binds such objects without calling their parse_node().
+    """
+    c = counters.get(cls)
+    if c != None:
+        c.elements += len([child for child in node.childNodes if child.nodeType == Node.ELEMENT_NODE])
+
+def instrument(cls):
+    """
+    Called at the end of the modules generated with --instrument, wraps the methods of cls so that they update its Counters.
+    Only calls on objects of exactly cls are counted, so that the calls from a class to the methods of its base aren't counted twice.
+    Elements and parsing time aren't counted for documents bound by the native backend or in worker processes.
+    """
+    c = counters[cls] = Counters()
+
+    def construct(func):
+        def __init__(self, *args, **kwargs):
+            if self.__class__ is cls:
+                c.objects += 1
+            func(self, *args, **kwargs)
+        return __init__
+
+    def parse(func):
+        def parse_node(self, node):
+            if self.__class__ is not cls:
+                return func(self, node)
+
+            start = default_timer()
+            try:
+                return func(self, node)
+            finally:
+                c.parse_seconds += default_timer() - start
+                c.elements += len([child for child in node.childNodes if child.nodeType == Node.ELEMENT_NODE])
+        return parse_node
+
+    def write(func):
+        def method(self, *args):
+            if self.__class__ is not cls:
+                return func(self, *args)
+
+            start = default_timer()
+            try:
+                return func(self, *args)
+            finally:
+                c.write_seconds += default_timer() - start
+        return method
+
+    def read(size):
+        def wrapper(func):
+            def factory(factoryClass, xml, *args, **kwargs):
+                if factoryClass is cls:
+                    c.bytes_in += size(xml)
+                return func(factoryClass, xml, *args, **kwargs)
+            return classmethod(factory)
+        return wrapper
+
+    def toxml(func):
+        def method(self):
+            data = func(self)
+            if self.__class__ is cls:
+                c.bytes_out += len(data)
+            return data
+        return method
+
+    def write_document(func):
+        def method(self, write):
+            if self.__class__ is not cls:
+                return func(self, write)
+
+            def counting(data):
+                c.bytes_out += len(data)
+                write(data)
+            func(self, counting)
+        return method
+
+    wrappers = [("__init__", construct), ("parse_node", parse), ("append_children", write), ("write_xml", write),
+                ("fromxml", read(fileSize)), ("fromxml_parallel", read(fileSize)), ("from_bytes", read(len)),
+                ("write_document", write_document)]
+
+    #toxml() of --dirty goes through write_document()
+    if getattr(cls.toxml, "__func__", cls.toxml) is not toxmlCached:
+        wrappers.append(("toxml", toxml))
+
+    for name, wrapper in wrappers:
+        method = getattr(cls, name, None)
+        if method != None:
+            setattr(cls, name, wrapper(getattr(method, "__func__", method)))
+
+    cls.expat_binder = CountingExpatBinder
+
+def parseFile(task):
+    """Parses a whole file in a worker process of fromxml_many()"""
+    cls, filename = task
+    return cls.fromxml(filename)
 
 class JamesXMLObject:
+    #the binder used by the expat backend, see instrument()
+    expat_binder = ExpatBinder
+
     def __init__(self):
         doc = None
 
@@ -29,15 +840,343 @@ class JamesXMLObject:
         self.append_children(root_node, newdoc)
         return newdoc.toxml("UTF-8")
 
-    def parsexml(self, xml):
-        dom = parse(xml)
+    def write_document(self, write):
+        """
+        Writes this object as a complete document by calling write() with pieces of the XML text.
+        Produces the same document as toxml(), without building a DOM tree, except that attributes are always sorted
+        by name and line breaks in values are written as character references.
+        """
+        write(xmlDeclaration)
+        self.write_xml(write, self.get_name(), self.get_namespace())
+
+    def write_stream(self, stream, chunk_size = 65536):
+        """
+        Writes this object as a complete document to stream, in chunks of about chunk_size characters.
+        Array members may be iterators or generators, whose items are then written as they are produced
+        so that only the current chunk is held in memory.
+        """
+        writer = ChunkedWriter(stream, chunk_size)
+        self.write_document(writer.write)
+        writer.flush()
+
+    @classmethod
+    def write_many(cls, objects, stream, framing = None):
+        """
+        Writes a sequence of documents to stream.
+        framing can be None for documents back to back, "newline" for a line break after each document,
+        or "length" for a 4-byte big-endian length before each document.
+        With "length" the documents are encoded as UTF-8, and stream has to be opened in binary mode.
+        """
+        write = stream.write
+
+        if framing == None:
+            for obj in objects:
+                obj.write_document(write)
+        elif framing == "newline":
+            for obj in objects:
+                obj.write_document(write)
+                write("\n")
+        elif framing == "length":
+            for obj in objects:
+                parts = []
+                obj.write_document(parts.append)
+                data = "".join(parts)
+
+                #the length is that of the encoded document. str is already bytes on Python 2
+                if not isinstance(data, bytes):
+                    data = data.encode("utf-8")
+
+                write(struct.pack(">I", len(data)))
+                write(data)
+        else:
+            raise ValueError("Unknown framing " + str(framing))
+
+    def lazy_member(self, name, bind, node, isArray = False):
+        """
+        Records that node should be bound into the member name by bind(node) when the member is first read.
+        The member is removed from the object until then, so that bindLazy() gets called.
+        """
+        pending = self.__dict__.setdefault("_pending", {})
+        self.__dict__.pop(name, None)
+
+        if isArray:
+            pending.setdefault(name, (bind, []))[1].append(node)
+        else:
+            pending[name] = (bind, node)
+
+    def to_columns(self, member):
+        """
+        Returns the items of the array member, of a complex type, as a dict with a column for each simple member
+        listed by the column_specs() of the item type: an array.array for required numeric members and a list otherwise.
+        Values of simple types are replaced by their content.
+        """
+        items = getattr(self, member)
+        columns = {}
+
+        for name, isAttribute, typecode, converter in getColumnClass(self.__class__, member)[1].column_specs():
+            values = [getattr(item, name) for item in items]
+            values = [value.content if isinstance(value, JamesXMLObject) else value for value in values]
+            columns[name] = array(typecode, values) if typecode else values
+
+        return columns
+
+    @classmethod
+    def iter_columns(cls, xml, member, batch_size = 65536):
+        """
+        Parses the document in the file xml, or file-like object, and yields the items of the array member
+        as dicts of columns like to_columns(), of at most batch_size items each, without creating an object per item.
+        The document is read in pieces, so memory use follows batch_size rather than the size of the document.
+        Values are converted but not validated.
+        """
+        binder = ColumnBinder(cls(), member, batch_size)
+        f = xml if hasattr(xml, "read") else open(xml, "rb")
+
+        try:
+            while True:
+                data = f.read(parseChunkSize)
+                binder.parser.Parse(data, not data)
+
+                if not data:
+                    binder.flush()
+
+                for batch in binder.batches:
+                    yield batch
+                del binder.batches[:]
+
+                if not data:
+                    break
+        finally:
+            if f is not xml:
+                f.close()
+
+    def parse_dom(self, dom):
         node = dom.documentElement
         if node.tagName == self.get_name():
             self.parse_node(node)
 
+    def parsexml(self, xml):
+        self.parse_dom(parse(xml))
+
+    def parsexml_expat(self, xml):
+        self.expat_binder(self).parse(xml)
+
+    def parsexml_projected(self, xml, fields):
+        """Binds only the given fields of the document, see getProjection()"""
+        self.expat_binder(self, getProjection(self.__class__, fields)).parse(xml)
+
+    def parsexml_native(self, xml):
+        #fall back on minidom if the extension module isn't available
+        if native == None:
+            return self.parsexml(xml)
+
+        if hasattr(xml, "read"):
+            native.parse(self, xml.read())
+            return
+
+        data = mapFile(xml)
+        try:
+            native.parse(self, data)
+        finally:
+            if isinstance(data, mmap.mmap):
+                data.close()
+
+    @classmethod
+    def fromxml_cached(cls, filename, cache_dir = None, check_contents = False):
+        """
+        Like fromxml(), but keeps a pickle of the parsed object in cache_dir and loads that instead of parsing
+        for as long as the file keeps its path, modification time and size.
+        With check_contents the contents of the file are hashed as well, which still reads the file but doesn't parse it.
+        cache_dir defaults to pyjames in the user's cache directory, and has to be private to the current user
+        (see openCacheDir()), since loading a pickle can run any code. Stale pickles are not removed.
+        """
+        import errno
+        import hashlib
+        import tempfile
+        try:
+            import cPickle as pickle
+        except ImportError:
+            import pickle
+
+        #the pickle protocol is part of the key, so that Python 2 and 3 don't load each other's pickles
+        stat = os.stat(filename)
+        key = hashlib.sha1()
+        key.update(repr((os.path.abspath(filename), stat.st_mtime, stat.st_size, stateFingerprint(cls), pickle.HIGHEST_PROTOCOL)).encode("utf-8"))
+
+        if check_contents:
+            f = open(filename, "rb")
+            try:
+                for chunk in iter(lambda: f.read(parseChunkSize), b""):
+                    key.update(chunk)
+            finally:
+                f.close()
+
+        cache_dir = openCacheDir(cache_dir)
+        cached = os.path.join(cache_dir, cls.__name__ + "-" + key.hexdigest() + ".pickle")
+
+        try:
+            f = open(cached, "rb")
+        except IOError as e:
+            #only a missing pickle is parsed and written, anything else is raised
+            if e.errno != errno.ENOENT:
+                raise
+        else:
+            try:
+                return pickle.load(f)
+            finally:
+                f.close()
+
+        obj = cls.fromxml(filename)
+
+        #mkstemp() creates the file with mode 0600, and the rename makes sure other processes never load a partial pickle
+        fd, temp = tempfile.mkstemp(dir = cache_dir)
+        f = os.fdopen(fd, "wb")
+        try:
+            pickle.dump(obj, f, pickle.HIGHEST_PROTOCOL)
+        finally:
+            f.close()
+
+        try:
+            os.rename(temp, cached)
+        except OSError:
+            #on Windows the rename fails if another process got there first
+            os.remove(temp)
+
+        return obj
+
+    @classmethod
+    def fromxml_many(cls, filenames, workers = None, chunksize = None):
+        """
+        Parses each of filenames with fromxml() in a pool of worker processes and yields the objects in the same order.
+        The objects are pickled back from the workers, so no XML is parsed twice.
+        Filenames are handed to the workers chunksize at a time, by default in about four batches per worker.
+        """
+        import multiprocessing
+
+        if workers == None:
+            workers = multiprocessing.cpu_count()
+
+        if workers <= 1:
+            for filename in filenames:
+                yield cls.fromxml(filename)
+            return
+
+        if chunksize == None:
+            chunksize = max(1, len(filenames) // (workers * 4)) if hasattr(filenames, "__len__") else 16
+
+        pool = multiprocessing.Pool(workers)
+
+        try:
+            for obj in pool.imap(parseFile, ((cls, filename) for filename in filenames), chunksize):
+                yield obj
+            pool.close()
+        finally:
+            pool.terminate()
+            pool.join()
+
+    def parsexml_parallel(self, filename, member, workers = None, min_size = 4 << 20):
+        """
+        Parses the file filename, whose root holds the array member, in a pool of worker processes.
+        The file is split at the start tags of member and each chunk is bound by a worker,
+        then the chunks are merged back into this object in order.
+        Files smaller than min_size, or documents that can't be split, are parsed by parsexml_expat() instead.
+        So are documents where a chunk doesn't parse, like one split inside a nested element that happens to
+        have the name of member, which also reports the errors of malformed documents at their real position.
+        """
+        import multiprocessing
+
+        if workers == None:
+            workers = multiprocessing.cpu_count()
+
+        if workers <= 1 or os.path.getsize(filename) < min_size:
+            return self.parsexml_expat(filename)
+
+        data = mapFile(filename)
+
+        try:
+            #the root start tag is the first tag that isn't a declaration, processing instruction or comment
+            root = re.compile(br"<([^?!/\s>][^\s/>]*)[^>]*>").search(data)
+            if root == None or data[root.end() - 2:root.end()] == b"/>":
+                return self.parsexml_expat(filename)
+
+            rootName = root.group(1)
+            bodyStart = root.end()
+            bodyEnd = data.rfind(b"</" + rootName)
+            if bodyEnd < bodyStart:
+                return self.parsexml_expat(filename)
+
+            #the array items are assumed to use the same prefix as the root
+            prefix = rootName[:rootName.find(b":") + 1]
+            item = re.compile(b"<" + prefix + member.encode("ascii") + br"[\s/>]")
+
+            splits = [bodyStart]
+            chunks = workers * 4
+            for x in range(1, chunks):
+                split = findSplit(data, item, splits[-1], max(splits[-1] + 1, bodyStart + (bodyEnd - bodyStart) * x // chunks), bodyEnd)
+                if split == None:
+                    break
+                splits.append(split)
+            splits.append(bodyEnd)
+
+            header = data[:bodyStart]
+            footer = data[bodyEnd:]
+        finally:
+            data.close()
+
+        tasks = [(self.__class__, filename, header, splits[x], splits[x + 1], footer) for x in range(len(splits) - 1)]
+        pool = multiprocessing.Pool(workers)
+
+        try:
+            parts = pool.map(parseChunk, tasks)
+            pool.close()
+        except xml.parsers.expat.ExpatError:
+            pool.terminate()
+            parts = None
+        except:
+            pool.terminate()
+            raise
+        finally:
+            pool.join()
+
+        if parts == None:
+            return self.parsexml_expat(filename)
+
+        #every part has the attributes of the root, each array item is in exactly one part.
+        #arrays are lists, or array.array with --typed-arrays
+        for part in parts:
+            for name, value in vars(part).items():
+                if isinstance(value, (list, array)):
+                    getattr(self, name).extend(value)
+                elif value != None:
+                    setattr(self, name, value)
+
+    def parsebytes(self, data):
+        """Parses a document held in bytes, bytearray, memoryview or mmap"""
+        if isinstance(data, (bytearray, memoryview)):
+            self.parse_dom(parse(BufferReader(memoryview(data))))
+        else:
+            self.parse_dom(parseString(data))
+
+    def parsebytes_expat(self, data):
+        self.expat_binder(self).parse_buffer(data)
+
+    def parsebytes_native(self, data):
+        if native == None:
+            return self.parsebytes(data)
+
+        native.parse(self, data)
+
+    def toxml_native(self):
+        if native == None:
+            return self.toxml()
+
+        return native.serialize(self)
+
     def append_children(self, node, document):
         pass
 
+    def write_xml(self, write, name, xmlns = None):
+        pass
+
     def parse_node(self, node):
         pass
 
@@ -48,13 +1187,10 @@ class JamesXMLObject:
         pass
     
     def strToBool(self, string):
-        if(string.lower() == "true" or string == "1"):
-            return True
-        return False
+        return strToBool(string)
 
     def strToHex(self, string):
-        import binascii
-        return binascii.unhexlify(string)
+        return strToHex(string)
 
 def main():
     pass